@@ -0,0 +1,468 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "storage_mgr.h"
+#include "dberror.h"
+#include "dt.h"
+#include "tables.h"
+#include "bitmap_mgr.h"
+
+/*
+ * On disk every bitmap is a list of marker words, each followed by literal
+ * words: a marker holds a fill bit, the number of all-0 or all-1 words the
+ * fill stands for and the number of literal words after it.
+ */
+#define MARKER(fill, run, lits) (((uint64_t) (fill) << 63) \
+		| ((uint64_t) (run) << 32) | (uint64_t) (lits))
+#define MARKER_FILL(m) ((int) ((m) >> 63))
+#define MARKER_RUN(m) ((int) (((m) >> 32) & 0x7fffffff))
+#define MARKER_LITS(m) ((int) ((m) & 0xffffffff))
+#define MAX_RUN 0x7fffffff
+#define ALL_ONES (~(uint64_t) 0)
+
+/* the file starts with total bytes, key type, key length, slots per page
+ * and number of values, then key, word count and words of every value */
+#define HEADER_INTS 5
+
+
+static Bitmap* new_bitmap(int slotsPerPage, int numWords) {
+	Bitmap *bitmap = (Bitmap *) malloc(sizeof(Bitmap));
+
+	bitmap->slotsPerPage = slotsPerPage;
+	bitmap->numWords = numWords;
+	bitmap->maxWords = (numWords > 0) ? numWords : 1;
+	bitmap->words = (uint64_t *) calloc(bitmap->maxWords, sizeof(uint64_t));
+	return bitmap;
+}
+
+/* makes the bitmap numWords long, the words added are zero */
+static void grow_bitmap(Bitmap *bitmap, int numWords) {
+	int max = bitmap->maxWords;
+
+	if (numWords <= bitmap->numWords) {
+		return;
+	}
+	if (numWords > max) {
+		while (max < numWords) {
+			max *= 2;
+		}
+		bitmap->words = (uint64_t *) realloc(bitmap->words,
+				max * sizeof(uint64_t));
+		bitmap->maxWords = max;
+	}
+	memset(bitmap->words + bitmap->numWords, 0,
+			(numWords - bitmap->numWords) * sizeof(uint64_t));
+	bitmap->numWords = numWords;
+}
+
+/* a value as its keyLength bytes, strings zero padded like in a record */
+static void key_bytes(Bitmap_stat *stat, Value *key, char *result) {
+	memset(result, 0, stat->keyLength);
+	switch (key->dt) {
+	case DT_INT:
+		memcpy(result, &key->v.intV, sizeof(int));
+		break;
+	case DT_FLOAT:
+		memcpy(result, &key->v.floatV, sizeof(float));
+		break;
+	case DT_BOOL:
+		memcpy(result, &key->v.boolV, sizeof(bool));
+		break;
+	case DT_STRING:
+		strncpy(result, key->v.stringV, stat->keyLength);
+		break;
+	}
+}
+
+/* the cardinality is low, a linear search over the values is enough */
+static int find_value(Bitmap_stat *stat, char *key) {
+	int i;
+
+	for (i = 0; i < stat->numValues; i++) {
+		if (memcmp(stat->values + i * stat->keyLength, key,
+				stat->keyLength) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int add_value(Bitmap_stat *stat, char *key) {
+	if (stat->numValues == stat->maxValues) {
+		stat->maxValues *= 2;
+		stat->values = (char *) realloc(stat->values,
+				stat->maxValues * stat->keyLength);
+		stat->bitmaps = (Bitmap **) realloc(stat->bitmaps,
+				stat->maxValues * sizeof(Bitmap *));
+	}
+	memcpy(stat->values + stat->numValues * stat->keyLength, key,
+			stat->keyLength);
+	stat->bitmaps[stat->numValues] = new_bitmap(stat->slotsPerPage, 0);
+	return stat->numValues++;
+}
+
+static Bitmap_stat* new_stat(int keyLength, int slotsPerPage) {
+	Bitmap_stat *stat = (Bitmap_stat *) malloc(sizeof(Bitmap_stat));
+
+	stat->keyLength = keyLength;
+	stat->slotsPerPage = slotsPerPage;
+	stat->numValues = 0;
+	stat->maxValues = 8;
+	stat->values = (char *) malloc(stat->maxValues * keyLength);
+	stat->bitmaps = (Bitmap **) malloc(stat->maxValues * sizeof(Bitmap *));
+	stat->dirty = false;
+	return stat;
+}
+
+/* run length encodes n words into out, which needs room for 2n words */
+static int compress_words(uint64_t *words, int n, uint64_t *out) {
+	int i = 0, len = 0, marker, run, lits, fill;
+
+	while (i < n) {
+		fill = (words[i] == ALL_ONES);
+		for (run = 0; i < n && run < MAX_RUN
+				&& words[i] == (fill ? ALL_ONES : 0); run++) {
+			i++;
+		}
+		marker = len++;
+		for (lits = 0; i < n && words[i] != 0 && words[i] != ALL_ONES; lits++) {
+			out[len++] = words[i++];
+		}
+		out[marker] = MARKER(fill, run, lits);
+	}
+	return len;
+}
+
+static void expand_words(uint64_t *in, int len, Bitmap *bitmap) {
+	int i = 0, start, run, lits;
+
+	while (i < len) {
+		run = MARKER_RUN(in[i]);
+		lits = MARKER_LITS(in[i]);
+		start = bitmap->numWords;
+		grow_bitmap(bitmap, start + run + lits);
+		if (MARKER_FILL(in[i])) {
+			memset(bitmap->words + start, 0xff, run * sizeof(uint64_t));
+		}
+		memcpy(bitmap->words + start + run, in + i + 1,
+				lits * sizeof(uint64_t));
+		i += 1 + lits;
+	}
+}
+
+/* writes the whole index as one byte stream over consecutive pages */
+static RC write_index(char *idxId, DataType keyType, Bitmap_stat *stat) {
+	SM_FileHandle fh;
+	uint64_t *packed;
+	char *data, *pos;
+	int i, size, len, numPages;
+	RC rc;
+
+	size = HEADER_INTS * sizeof(int);
+	for (i = 0; i < stat->numValues; i++) {
+		size += stat->keyLength + sizeof(int)
+				+ 2 * stat->bitmaps[i]->numWords * sizeof(uint64_t);
+	}
+	numPages = size / PAGE_SIZE + 1;
+	data = (char *) calloc(numPages, PAGE_SIZE);
+	pos = data + HEADER_INTS * sizeof(int);
+	for (i = 0; i < stat->numValues; i++) {
+		packed = (uint64_t *) malloc(
+				(2 * stat->bitmaps[i]->numWords + 1) * sizeof(uint64_t));
+		len = compress_words(stat->bitmaps[i]->words,
+				stat->bitmaps[i]->numWords, packed);
+		memcpy(pos, stat->values + i * stat->keyLength, stat->keyLength);
+		pos += stat->keyLength;
+		memcpy(pos, &len, sizeof(int));
+		pos += sizeof(int);
+		memcpy(pos, packed, len * sizeof(uint64_t));
+		pos += len * sizeof(uint64_t);
+		free(packed);
+	}
+	((int *) data)[0] = pos - data;
+	((int *) data)[1] = keyType;
+	((int *) data)[2] = stat->keyLength;
+	((int *) data)[3] = stat->slotsPerPage;
+	((int *) data)[4] = stat->numValues;
+
+	rc = openPageFile(idxId, &fh);
+	if (rc != RC_OK) {
+		free(data);
+		return rc;
+	}
+	numPages = (pos - data + PAGE_SIZE - 1) / PAGE_SIZE;
+	ensureCapacity(numPages, &fh);
+	for (i = 0; i < numPages && rc == RC_OK; i++) {
+		rc = writeBlock(i, &fh, data + i * PAGE_SIZE);
+	}
+	closePageFile(&fh);
+	free(data);
+	return rc;
+}
+
+RC createBitmapIndex(char *idxId, DataType keyType, int keyLength,
+		int slotsPerPage) {
+	Bitmap_stat *stat;
+	RC rc;
+
+	if (keyLength <= 0 || slotsPerPage <= 0) {
+		return RC_IM_N_TO_LAGE;
+	}
+	rc = createPageFile(idxId);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	stat = new_stat(keyLength, slotsPerPage);
+	rc = write_index(idxId, keyType, stat);
+	free(stat->values);
+	free(stat->bitmaps);
+	free(stat);
+	return rc;
+}
+
+RC openBitmapIndex(BitmapHandle **index, char *idxId) {
+	SM_FileHandle fh;
+	Bitmap_stat *stat;
+	BitmapHandle *handle;
+	uint64_t *packed;
+	char *data, *pos;
+	int i, size, len, numValues, numPages;
+	RC rc;
+
+	rc = openPageFile(idxId, &fh);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	data = (char *) malloc(PAGE_SIZE);
+	rc = readBlock(0, &fh, data);
+	if (rc != RC_OK) {
+		closePageFile(&fh);
+		free(data);
+		return rc;
+	}
+	size = ((int *) data)[0];
+	numPages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	data = (char *) realloc(data, numPages * PAGE_SIZE);
+	for (i = 1; i < numPages && rc == RC_OK; i++) {
+		rc = readBlock(i, &fh, data + i * PAGE_SIZE);
+	}
+	closePageFile(&fh);
+	if (rc != RC_OK) {
+		free(data);
+		return rc;
+	}
+
+	handle = (BitmapHandle *) malloc(sizeof(BitmapHandle));
+	handle->keyType = ((int *) data)[1];
+	stat = new_stat(((int *) data)[2], ((int *) data)[3]);
+	numValues = ((int *) data)[4];
+	pos = data + HEADER_INTS * sizeof(int);
+	for (i = 0; i < numValues; i++) {
+		add_value(stat, pos);
+		pos += stat->keyLength;
+		memcpy(&len, pos, sizeof(int));
+		pos += sizeof(int);
+		packed = (uint64_t *) malloc((len + 1) * sizeof(uint64_t));
+		memcpy(packed, pos, len * sizeof(uint64_t));
+		pos += len * sizeof(uint64_t);
+		expand_words(packed, len, stat->bitmaps[i]);
+		free(packed);
+	}
+	free(data);
+
+	handle->idxId = idxId;
+	handle->mgmtData = stat;
+	*index = handle;
+	return RC_OK;
+}
+
+RC flushBitmapIndex(BitmapHandle *index) {
+	Bitmap_stat *stat = index->mgmtData;
+	RC rc;
+
+	if (!stat->dirty) {
+		return RC_OK;
+	}
+	rc = write_index(index->idxId, index->keyType, stat);
+	if (rc == RC_OK) {
+		stat->dirty = false;
+	}
+	return rc;
+}
+
+RC closeBitmapIndex(BitmapHandle *index) {
+	Bitmap_stat *stat = index->mgmtData;
+	int i;
+	RC rc;
+
+	rc = flushBitmapIndex(index);
+	for (i = 0; i < stat->numValues; i++) {
+		freeBitmap(stat->bitmaps[i]);
+	}
+	free(stat->values);
+	free(stat->bitmaps);
+	free(stat);
+	index->idxId = NULL;
+	free(index);
+	return rc;
+}
+
+RC deleteBitmapIndex(char *idxId) {
+	destroyPageFile(idxId);
+	return RC_OK;
+}
+
+RC setBitmapEntry(BitmapHandle *index, Value *key, RID rid) {
+	Bitmap_stat *stat = index->mgmtData;
+	Bitmap *bitmap;
+	char *bytes = (char *) malloc(stat->keyLength);
+	int v, bit;
+
+	key_bytes(stat, key, bytes);
+	v = find_value(stat, bytes);
+	if (v < 0) {
+		v = add_value(stat, bytes);
+	}
+	free(bytes);
+	bitmap = stat->bitmaps[v];
+	bit = rid.page * stat->slotsPerPage + rid.slot;
+	grow_bitmap(bitmap, bit / 64 + 1);
+	bitmap->words[bit / 64] |= (uint64_t) 1 << (bit % 64);
+	stat->dirty = true;
+	return RC_OK;
+}
+
+RC clearBitmapEntry(BitmapHandle *index, Value *key, RID rid) {
+	Bitmap_stat *stat = index->mgmtData;
+	Bitmap *bitmap;
+	char *bytes = (char *) malloc(stat->keyLength);
+	int v, bit;
+
+	key_bytes(stat, key, bytes);
+	v = find_value(stat, bytes);
+	free(bytes);
+	if (v < 0) {
+		return RC_IM_KEY_NOT_FOUND;
+	}
+	bitmap = stat->bitmaps[v];
+	bit = rid.page * stat->slotsPerPage + rid.slot;
+	if (bit / 64 >= bitmap->numWords) {
+		return RC_IM_KEY_NOT_FOUND;
+	}
+	bitmap->words[bit / 64] &= ~((uint64_t) 1 << (bit % 64));
+	stat->dirty = true;
+	return RC_OK;
+}
+
+RC getNumValues(BitmapHandle *index, int *result) {
+	Bitmap_stat *stat = index->mgmtData;
+
+	*result = stat->numValues;
+	return RC_OK;
+}
+
+/*
+ * Copy of the rows holding key, empty when no row ever did. The caller
+ * combines it with others and frees it with freeBitmap.
+ */
+RC getValueBitmap(BitmapHandle *index, Value *key, Bitmap **result) {
+	Bitmap_stat *stat = index->mgmtData;
+	Bitmap *bitmap;
+	char *bytes = (char *) malloc(stat->keyLength);
+	int v;
+
+	key_bytes(stat, key, bytes);
+	v = find_value(stat, bytes);
+	free(bytes);
+	if (v < 0) {
+		*result = new_bitmap(stat->slotsPerPage, 0);
+		return RC_OK;
+	}
+	bitmap = stat->bitmaps[v];
+	*result = new_bitmap(stat->slotsPerPage, bitmap->numWords);
+	memcpy((*result)->words, bitmap->words,
+			bitmap->numWords * sizeof(uint64_t));
+	return RC_OK;
+}
+
+/* the loops below are plain word loops the compiler can vectorize */
+RC bitmapAnd(Bitmap *result, Bitmap *other) {
+	int i, n = result->numWords;
+
+	if (other->numWords < n) {
+		n = other->numWords;
+	}
+	for (i = 0; i < n; i++) {
+		result->words[i] &= other->words[i];
+	}
+	result->numWords = n;
+	return RC_OK;
+}
+
+RC bitmapOr(Bitmap *result, Bitmap *other) {
+	int i;
+
+	grow_bitmap(result, other->numWords);
+	for (i = 0; i < other->numWords; i++) {
+		result->words[i] |= other->words[i];
+	}
+	return RC_OK;
+}
+
+/* complement over the slots of pages firstPage to lastPage, the bits of
+ * any other page are cleared */
+RC bitmapNot(Bitmap *result, int firstPage, int lastPage) {
+	int first = firstPage * result->slotsPerPage;
+	int end = (lastPage + 1) * result->slotsPerPage;
+	int i, n = (end + 63) / 64;
+
+	grow_bitmap(result, n);
+	result->numWords = n;
+	for (i = 0; i < n; i++) {
+		result->words[i] = ~result->words[i];
+	}
+	for (i = 0; i < first / 64; i++) {
+		result->words[i] = 0;
+	}
+	if (first % 64 != 0) {
+		result->words[first / 64] &= ALL_ONES << (first % 64);
+	}
+	if (end % 64 != 0) {
+		result->words[end / 64] &= ((uint64_t) 1 << (end % 64)) - 1;
+	}
+	return RC_OK;
+}
+
+int bitmapCount(Bitmap *bitmap) {
+	int i, count = 0;
+
+	for (i = 0; i < bitmap->numWords; i++) {
+		count += __builtin_popcountll(bitmap->words[i]);
+	}
+	return count;
+}
+
+/* the rows of the set bits, in page and slot order */
+RC bitmapToRids(Bitmap *bitmap, RID **rids, int *numRids) {
+	uint64_t word;
+	int i, bit, n = 0;
+
+	*rids = (RID *) malloc((bitmapCount(bitmap) + 1) * sizeof(RID));
+	for (i = 0; i < bitmap->numWords; i++) {
+		for (word = bitmap->words[i]; word != 0; word &= word - 1) {
+			bit = i * 64 + __builtin_ctzll(word);
+			(*rids)[n].page = bit / bitmap->slotsPerPage;
+			(*rids)[n].slot = bit % bitmap->slotsPerPage;
+			n++;
+		}
+	}
+	*numRids = n;
+	return RC_OK;
+}
+
+RC freeBitmap(Bitmap *bitmap) {
+	free(bitmap->words);
+	free(bitmap);
+	return RC_OK;
+}
@@ -0,0 +1,59 @@
+#ifndef BITMAP_MGR_H
+#define BITMAP_MGR_H
+
+#include <stdint.h>
+#include "dberror.h"
+#include "tables.h"
+
+// one bit per row slot, bit page * slotsPerPage + slot. Held as plain 64 bit
+// words in memory so that AND, OR and NOT work a word at a time.
+typedef struct Bitmap {
+	int slotsPerPage;
+	int numWords;
+	int maxWords;
+	uint64_t *words;
+} Bitmap;
+
+// one bitmap per distinct value of the indexed attribute
+typedef struct Bitmap_stat {
+	int keyLength;
+	int slotsPerPage;
+	int numValues;
+	int maxValues;
+	char *values;	// numValues keys of keyLength bytes, see key_bytes
+	Bitmap **bitmaps;
+	bool dirty;	// changed since the page file was last written
+} Bitmap_stat;
+
+// structure for accessing bitmap indexes
+typedef struct BitmapHandle {
+  DataType keyType;
+  char *idxId;
+  void *mgmtData;
+} BitmapHandle;
+
+// create, destroy, open, and close a bitmap index, the bitmaps are
+// kept run length compressed in the page file. Entries are only set and
+// cleared in memory, the file is rewritten by flushBitmapIndex and by
+// closeBitmapIndex, and only if something changed since the last write
+extern RC createBitmapIndex (char *idxId, DataType keyType, int keyLength, int slotsPerPage);
+extern RC openBitmapIndex (BitmapHandle **index, char *idxId);
+extern RC flushBitmapIndex (BitmapHandle *index);
+extern RC closeBitmapIndex (BitmapHandle *index);
+extern RC deleteBitmapIndex (char *idxId);
+
+// index access
+extern RC setBitmapEntry (BitmapHandle *index, Value *key, RID rid);
+extern RC clearBitmapEntry (BitmapHandle *index, Value *key, RID rid);
+extern RC getNumValues (BitmapHandle *index, int *result);
+extern RC getValueBitmap (BitmapHandle *index, Value *key, Bitmap **result);
+
+// bitmap operations, result is updated in place
+extern RC bitmapAnd (Bitmap *result, Bitmap *other);
+extern RC bitmapOr (Bitmap *result, Bitmap *other);
+extern RC bitmapNot (Bitmap *result, int firstPage, int lastPage);
+extern int bitmapCount (Bitmap *bitmap);
+extern RC bitmapToRids (Bitmap *bitmap, RID **rids, int *numRids);
+extern RC freeBitmap (Bitmap *bitmap);
+
+#endif // BITMAP_MGR_H
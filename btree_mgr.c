@@ -12,16 +12,30 @@
 #include "btree_mgr.h"
 
 
-extern void * initialNode;
-void * initialNode = NULL;
 Btree *queue = NULL;
+static int openCount = 0;
+
+/* keys are fixed width byte strings ordered by memcmp, see encode_key */
+#define KEY(node, i) ((node)->keys + (i) * (node)->keySize)
+#define STRING_KEY_LENGTH 32
 
 
 
 RC update(char *data, DataType keyType, int n, int noNodes, int type);
 RC insertRoot(BTreeHandle *tree, Btree_stat *root, Btree *old_node,
-		int key);
+		Btree *left_child, Btree *right_child, char *key);
+RC insert_parent(BTreeHandle* tree, Btree_stat *root, Btree *old_node,
+		Btree *new_node, char *new_key);
+RC insertLeaf(Btree *root, char *key, RID rid, char *payload);
 RC updateStat(BTreeHandle *bhandle, Btree_stat* stat);
+RC flushStat(BTreeHandle *bhandle, Btree_stat* stat);
+int coverWidth(Btree_cover *cover, int i);
+Btree_cover* readCover(char *data);
+Btree_key* readKeyDesc(char *data);
+int keyDescSize(Btree_key *desc);
+Btree* find_leaf_bounded(Btree_stat *stat, char *key, char *upper,
+		bool *bounded);
+Btree* seek_leaf(Btree_stat *stat, Scankey *keydata, int *numrec);
 
 
 RC initIndexManager(void* mgmtData) {
@@ -33,253 +47,293 @@ RC shutdownIndexManager() {
 }
 Btree* createNode(BTreeHandle* tree) {
 	unsigned int blkNum = -1;
-	Btree *new_node = ((Btree *) malloc (sizeof(Btree)));
+	Btree *new_node;
 	Btree_stat *stat = tree->mgmtData;
-	BM_PageHandle *bh = MAKE_PAGE_HANDLE();
-	pinPage(stat->fileInfo, bh, 0);
+	BM_PageHandle *bh = stat->header;
+
+	// nodes released by deleteRange are recycled before allocating
+	if (stat->freeNodes != NULL) {
+		new_node = stat->freeNodes;
+		stat->freeNodes = new_node->next;
+		memset(new_node->pointers, 0, (stat->order + 1) * sizeof(void *));
+		memset(new_node->payloads, 0, stat->order * sizeof(char *));
+		new_node->is_leaf = true;
+		new_node->num_keys = 0;
+		new_node->version++;
+		new_node->refs = 1;
+		new_node->parent = NULL;
+		new_node->next = NULL;
+		new_node->prev = NULL;
+		return new_node;
+	}
+	new_node = ((Btree *) malloc (sizeof(Btree)));
 	memcpy(&blkNum, bh->data, sizeof(int));
 	blkNum = blkNum + 1;
 	if (new_node == NULL) {
 		return NULL;
 	}
-	new_node->keys = malloc(stat->order * sizeof(int));
+	new_node->keySize = stat->key->size;
+	new_node->keys = malloc(stat->order * stat->key->size);
 	new_node->records = malloc(stat->order * sizeof(void *));
-	new_node->pointers = malloc((stat->order + 1) * sizeof(void *));
+	new_node->pointers = calloc(stat->order + 1, sizeof(void *));
+	new_node->payloads = calloc(stat->order, sizeof(char *));
 	new_node->blkNum = blkNum;
 	new_node->is_leaf = true;
 	new_node->num_keys = 0;
+	new_node->version = 0;
+	new_node->refs = 1;
 	new_node->parent = NULL;
 	new_node->next = NULL;
 	new_node->prev = NULL;
 	update(bh->data, tree->keyType, stat->order, 0, 1);
 	markDirty(stat->fileInfo, bh);
-	unpinPage(stat->fileInfo, bh);
-	forceFlushPool(stat->fileInfo);
-	free(bh);
 	return new_node;
 }
 
-RC update_parent_nodes(Btree *child) {
-	Btree *parent;
-	int i = 0, j;
-	parent = child->parent;
-	if (parent != NULL) {
-		for (i = 0; i < parent->num_keys; i++) {
-			if (parent->keys[i] == child->keys[0]) {
-				break;
+/*
+ * Make node private to the live tree before it is modified. While
+ * snapshots are open, nodes reachable from one are shared: the path
+ * above node is made private first, then node itself is copied if a
+ * snapshot still refers to it. Returns the node to modify. Every
+ * writer comes through here, so this is also where versions advance.
+ */
+Btree* cow_node(BTreeHandle *tree, Btree *node) {
+	Btree_stat *stat = tree->mgmtData;
+	Btree *copy, *parent = NULL;
+	int i;
+
+	node->version++;
+	if (stat->snapshots == 0) {
+		return node;
+	}
+	if (node->parent != NULL) {
+		parent = cow_node(tree, node->parent);
+	}
+	if (node->refs == 1) {
+		return node;
+	}
+	copy = createNode(tree);
+	copy->is_leaf = node->is_leaf;
+	copy->num_keys = node->num_keys;
+	memcpy(copy->keys, node->keys, node->num_keys * node->keySize);
+	if (node->is_leaf) {
+		memcpy(copy->records, node->records, node->num_keys * sizeof(RID));
+		for (i = 0; i < node->num_keys; i++) {
+			if (node->payloads[i] != NULL) {
+				copy->payloads[i] = malloc(stat->cover->size);
+				memcpy(copy->payloads[i], node->payloads[i], stat->cover->size);
 			}
 		}
+	} else {
+		for (i = 0; i <= node->num_keys; i++) {
+			copy->pointers[i] = node->pointers[i];
+			copy->pointers[i]->refs++;
+			copy->pointers[i]->parent = copy;
+		}
+	}
 
-		for (j = i; j < parent->num_keys; j++) {
-			parent->keys[j] = parent->keys[j + 1];
-			parent->pointers[j] = parent->pointers[j + 1];
+	// snapshots never follow parent or sibling links, so those may be
+	// redirected even in shared nodes
+	copy->parent = parent;
+	copy->prev = node->prev;
+	copy->next = node->next;
+	if (copy->prev != NULL) {
+		copy->prev->next = copy;
+	}
+	if (copy->next != NULL) {
+		copy->next->prev = copy;
+	}
+	if (parent == NULL) {
+		stat->mgmtData = copy;
+	} else {
+		for (i = 0; parent->pointers[i] != node; i++)
+			;
+		parent->pointers[i] = copy;
+	}
+	if (stat->rightLeaf == node) {
+		stat->rightLeaf = copy;
+	}
+	node->refs--;
+	return copy;
+}
+
+/*
+ * Drop one reference to node. A node no tree refers to any more goes
+ * to the free list, together with the children only it referred to.
+ */
+void release_node(Btree_stat *stat, Btree *node) {
+	int i;
+
+	if (--node->refs > 0) {
+		return;
+	}
+	if (node->is_leaf) {
+		for (i = 0; i < node->num_keys; i++) {
+			free(node->payloads[i]);
+			node->payloads[i] = NULL;
 		}
-		if (parent->num_keys == 0) {
-			merge_nodes(parent->prev, parent);
-			return RC_OK;
+	} else {
+		for (i = 0; i <= node->num_keys; i++) {
+			release_node(stat, node->pointers[i]);
 		}
-		update_parent_nodes(parent);
 	}
-	return RC_OK;
+	node->version++;
+	node->next = stat->freeNodes;
+	stat->freeNodes = node;
 }
 
 int splitNode(int node_len) {
 	if (node_len % 2 == 0) {
 		return node_len / 2;
 	} else {
-		return node_len + 1 / 2;
+		return (node_len + 1) / 2;
 	}
 }
 
 
 RC Split_and_insert(BTreeHandle* tree, Btree_stat *root, Btree *old_node,
-		Value* key, RID rid) {
+		char *key, RID rid, char *payload) {
 
-	Btree *new_node, *temp1;
+	Btree *new_node;
 	Btree_stat *stat;
 	int index = 0, i = 0, j = 0;
-	int *temp_array_keys;
+	char *temp_array_keys;
 	RID *temp_array_pointers;
-	int split_pos, num_new_node = 0, new_key = 0;
+	char **temp_array_payloads;
+	int split_pos, num_new_node = 0, size;
 
 	stat = tree->mgmtData;
+	size = stat->key->size;
 
-	if (old_node->next == NULL) {
-		new_node = createNode(tree);
-		stat->num_nodes++;
-		old_node->next = new_node;
-		new_node->prev = old_node;
-
-		temp_array_keys = malloc((stat->order + 1) * sizeof(int));
-
-		temp_array_pointers = malloc((stat->order + 1) * sizeof(void));
+	new_node = createNode(tree);
+	stat->num_nodes++;
+	new_node->next = old_node->next;
+	if (old_node->next != NULL) {
+		old_node->next->prev = new_node;
+	}
+	old_node->next = new_node;
+	new_node->prev = old_node;
+	if (stat->rightLeaf == old_node) {
+		stat->rightLeaf = new_node;
+	}
 
-		while (index < old_node->num_keys && old_node->keys[index] < key->v.intV) {
-			index++; //find index such that it is less than order and value must be greater than other elements
-		}
+	temp_array_keys = malloc((stat->order + 1) * size);
+	temp_array_pointers = malloc((stat->order + 1) * sizeof(RID));
+	temp_array_payloads = malloc((stat->order + 1) * sizeof(char *));
 
-		do {
-			if (j == index) {
-				j++;
-			}
-			temp_array_keys[j] = old_node->keys[i];
-			temp_array_pointers[j] = old_node->records[i];
-			i++;
-			j++;
-		} while (i < old_node->num_keys);
-		temp_array_keys[index] = key->v.intV;
-		temp_array_pointers[index] = rid;
-		split_pos = 1 + splitNode(stat->order);
-		old_node->num_keys = 0;
-		j = 0;
-		for (i = 0; i < split_pos; i++) {
-
-			old_node->keys[i] = temp_array_keys[i];
-			old_node->records[i] = temp_array_pointers[i];
-			old_node->num_keys++;
-			j++;
-		}
-		num_new_node = stat->order + 1 - split_pos;
+	while (index < old_node->num_keys
+			&& memcmp(KEY(old_node, index), key, size) < 0) {
+		index++; //find index such that it is less than order and value must be greater than other elements
+	}
 
-		for (i = 0; i < num_new_node; i++) {
-			new_node->keys[i] = temp_array_keys[j];
-			new_node->records[i] = temp_array_pointers[j];
-			new_node->num_keys++;
-			j++;
-		}
-		new_node->parent = old_node->parent;
-		new_key = new_node->keys[0];
-		insert_parent(tree, root, old_node, new_node, new_key);
-	} else {
-		temp1 = old_node->next;
-		int k = 0;
-		k = old_node->num_keys;
-		if (temp1->num_keys < stat->order
-				&& old_node->keys[k - 1] < key->v.intV) {
-			new_node = temp1;
-			insertLeaf(new_node, key, rid);
-			return RC_OK;
-		} else {
-			new_node = createNode(tree);
-			stat->num_nodes++;
-			old_node->next = new_node;
-			new_node->prev = old_node;
-			new_node->next = temp1;
-			temp1->prev = new_node;
-		}
-		temp_array_keys = malloc((stat->num_inserts + 1) * sizeof(int));
-		temp_array_pointers = malloc((stat->num_inserts + 1) * sizeof(void));
-		while (index < old_node->num_keys && old_node->keys[index] < key->v.intV) {
-			index++; //find index such that it is less than order and value must be greater than other elements
-		}
-		do {
-			if (j == index) {
-				j++;
-			}
-			temp_array_keys[j] = old_node->keys[i];
-			temp_array_pointers[j] = old_node->records[i];
-			i++;
-			j++;
-		} while (i < old_node->num_keys);
-		temp_array_keys[index] = key->v.intV;
-		temp_array_pointers[index] = rid;
-		split_pos = 1 + splitNode(stat->order);
-		old_node->num_keys = 0;
-		j = 0;
-		for (i = 0; i < split_pos; i++) {
-			old_node->keys[i] = temp_array_keys[i];
-			old_node->records[i] = temp_array_pointers[i];
-			old_node->num_keys++;
+	for (i = 0, j = 0; i < old_node->num_keys; i++, j++) {
+		if (j == index) {
 			j++;
 		}
-		num_new_node = stat->order + 1 - split_pos;
-		for (i = 0; i < num_new_node; i++) {
+		memcpy(temp_array_keys + j * size, KEY(old_node, i), size);
+		temp_array_pointers[j] = old_node->records[i];
+		temp_array_payloads[j] = old_node->payloads[i];
+	}
+	memcpy(temp_array_keys + index * size, key, size);
+	temp_array_pointers[index] = rid;
+	temp_array_payloads[index] = payload;
 
-			new_node->keys[i] = temp_array_keys[j];
-			new_node->records[i] = temp_array_pointers[j];
-			new_node->num_keys++;
-			j++;
-		}
-		root->mgmtData = new_node;
-		new_node->parent = old_node->parent;
-		new_key = new_node->keys[0];
-		insert_parent(tree, root, old_node, new_node, new_key);
+	// left node keeps the larger half of the order + 1 keys
+	split_pos = splitNode(stat->order + 1);
+	old_node->num_keys = 0;
+	for (i = 0; i < split_pos; i++) {
+		memcpy(KEY(old_node, i), temp_array_keys + i * size, size);
+		old_node->records[i] = temp_array_pointers[i];
+		old_node->payloads[i] = temp_array_payloads[i];
+		old_node->num_keys++;
+	}
+	num_new_node = stat->order + 1 - split_pos;
+	for (i = 0, j = split_pos; i < num_new_node; i++, j++) {
+		memcpy(KEY(new_node, i), temp_array_keys + j * size, size);
+		new_node->records[i] = temp_array_pointers[j];
+		new_node->payloads[i] = temp_array_payloads[j];
+		new_node->num_keys++;
 	}
+	new_node->parent = old_node->parent;
+	insert_parent(tree, root, old_node, new_node, KEY(new_node, 0));
+
+	free(temp_array_keys);
 	free(temp_array_pointers);
+	free(temp_array_payloads);
 	return RC_OK;
 }
 
-RC update_parent_node(Btree *right_node, int key) {
-	right_node = right_node->parent;
-	while (right_node != NULL) {
-		if (right_node->is_leaf == false) {
-			right_node->keys[0] = key;
-		}
-		right_node = right_node->parent;
-	}
+/*
+ * Right-edge append: key is larger than every key in the full rightmost
+ * leaf, so instead of a 50/50 split we leave that leaf full and start a
+ * fresh leaf holding only the new key. Sequential loads end up with
+ * full leaves instead of half empty ones.
+ */
+RC append_new_leaf(BTreeHandle* tree, Btree_stat *root, Btree *old_node,
+		char *key, RID rid, char *payload) {
+	Btree *new_node;
+
+	new_node = createNode(tree);
+	root->num_nodes++;
+	old_node->next = new_node;
+	new_node->prev = old_node;
+	new_node->parent = old_node->parent;
+	memcpy(KEY(new_node, 0), key, new_node->keySize);
+	new_node->records[0] = rid;
+	new_node->payloads[0] = payload;
+	new_node->num_keys = 1;
+	root->rightLeaf = new_node;
+	insert_parent(tree, root, old_node, new_node, KEY(new_node, 0));
 	return RC_OK;
 }
 
+/*
+ * Returns the cached rightmost leaf if it is still linked in at the end
+ * of the leaf chain and key sorts after all of its entries, NULL otherwise.
+ */
+Btree* right_edge_leaf(Btree_stat *root, char *key) {
+	Btree *leaf = root->rightLeaf;
 
-
-
-
-
-
-Btree* find_node_to_insert(Btree_stat *root, Value* key) {
-	Btree *node, *prev;
-	node = initialNode;
-	prev = node;
-	while (node != NULL) {
-		if (node->is_leaf == true) {
-			if (node->keys[0] > key->v.intV) {
-				return prev;
-			}
-		}
-		prev = node;
-		node = node->next;
+	if (leaf == NULL || leaf->is_leaf == false || leaf->next != NULL
+			|| leaf->num_keys == 0) {
+		return NULL;
 	}
-	return prev;
-}
-
-bool checkUnderflow(Btree_stat* stat, Btree * node) {
-	if (stat->order % 2 == 0) {
-		if (node->num_keys < (stat->order) / 2) {
-			return true;
-		}
-	} else {
-		if (node->num_keys < (stat->order + 1) / 2) {
-			return true;
-		}
+	if (leaf->prev != NULL && leaf->prev->next != leaf) {
+		return NULL;
+	}
+	if (memcmp(KEY(leaf, leaf->num_keys - 1), key, leaf->keySize) >= 0) {
+		return NULL;
 	}
-	return false;
+	return leaf;
 }
 
 
 
-
-RC insertLeaf(Btree *root, Value* key, RID rid) {
+RC insertLeaf(Btree *root, char *key, RID rid, char *payload) {
 
 	int index = 0, i = 0;
 
-	while (index < root->num_keys && root->keys[index] < key->v.intV) {
+	while (index < root->num_keys
+			&& memcmp(KEY(root, index), key, root->keySize) < 0) {
 		index++;
 	}
 
 	for (i = root->num_keys; i > index; i--) {
-		root->keys[i] = root->keys[i - 1];
+		memcpy(KEY(root, i), KEY(root, i - 1), root->keySize);
 		root->records[i] = root->records[i - 1];
+		root->payloads[i] = root->payloads[i - 1];
 	}
 
-	root->keys[index] = key->v.intV;
+	memcpy(KEY(root, index), key, root->keySize);
 	root->records[index] = rid;
+	root->payloads[index] = payload;
 	root->num_keys++;
 	return RC_OK;
 }
 
 
 
-Btree* find_leaf(BTreeHandle *tree, Value *key) {
+Btree* find_leaf(BTreeHandle *tree, char *key) {
 	Btree *root, *temp1;
 	Btree_stat *btstat;
 	btstat = tree->mgmtData;
@@ -288,59 +342,160 @@ Btree* find_leaf(BTreeHandle *tree, Value *key) {
 	root = btstat->mgmtData;
 	temp1 = root;
 	while (temp1->is_leaf == false) {
+		root = temp1;
+		temp1 = root->pointers[root->num_keys];
 		for (i = 0; i < root->num_keys; i++) {
-			if (key->v.intV < root->keys[i]) {
+			if (memcmp(key, KEY(root, i), root->keySize) < 0) {
 				temp1 = root->pointers[i];
 				break;
-			} else {
-				temp1 = root->pointers[i + 1];
 			}
 		}
 	}
 	return temp1;
 }
 
-RC delete_entry(BTreeHandle *tree, Btree *node, Value *key) {
-	int i = 0, j;
 
-	while (node->keys[i] != key->v.intV) {
-		i++;
+
+RC createNew(Btree *root, char *key, RID rid, char *payload) {
+
+	root->is_leaf = true;
+	memcpy(KEY(root, 0), key, root->keySize);
+	root->records[0] = rid;
+	root->payloads[0] = payload;
+	root->parent = NULL;
+	root->num_keys++;
+	return RC_OK;
+
+}
+
+int coverWidth(Btree_cover *cover, int i) {
+	switch (cover->dataTypes[i]) {
+	case DT_INT:
+		return sizeof(int);
+	case DT_FLOAT:
+		return sizeof(float);
+	case DT_BOOL:
+		return sizeof(bool);
+	default:
+		return cover->typeLength[i];
 	}
-	if (node->num_keys > 1) {
-		for (j = i; j < node->num_keys - 1; j++) {
-			node->keys[j] = node->keys[j + 1];
-			node->records[j] = node->records[j + 1];
-			node->pointers[j] = node->pointers[j + 1];
+}
+
+int keyWidth(DataType dataType, int typeLength) {
+	switch (dataType) {
+	case DT_INT:
+		return sizeof(int);
+	case DT_FLOAT:
+		return sizeof(float);
+	case DT_BOOL:
+		return 1;
+	default:
+		return typeLength;
+	}
+}
+
+/*
+ * Encode the first numVals key columns into buf so that memcmp on the
+ * result orders like the values themselves: ints and floats big endian
+ * with the sign bit handled, strings zero padded to their length. A
+ * string longer than its column is refused with RC_IM_N_TO_LAGE rather
+ * than cut, as two keys sharing that prefix would then collide.
+ * Columns past numVals are filled with pad, 0x00 for the smallest key
+ * starting with the given prefix and 0xff for the largest. *len is set
+ * to the number of bytes the given columns take.
+ */
+RC encode_key(Btree_key *desc, Value **vals, int numVals, char *buf, int pad,
+		int *len) {
+	unsigned char *out = (unsigned char *) buf;
+	unsigned int bits;
+	int i, width, offset = 0;
+
+	if (numVals > desc->numAttr) {
+		return RC_IM_N_TO_LAGE;
+	}
+	for (i = 0; i < numVals; i++) {
+		if (vals[i]->dt != desc->dataTypes[i]) {
+			return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
 		}
-		node->pointers[j] = node->pointers[j + 1];
-		node->num_keys--;
-	} else {
-		node->keys[i] = NULL;
-		node->records[i].slot = 0;
-		node->records[i].page = 0;
-		node->pointers[i] = NULL;
-		node->num_keys--;
-		if (node->num_keys != 0) {
-			merge_nodes(node->prev, node);
+		width = keyWidth(desc->dataTypes[i], desc->typeLength[i]);
+		switch (desc->dataTypes[i]) {
+		case DT_INT:
+		case DT_FLOAT:
+			if (desc->dataTypes[i] == DT_INT) {
+				bits = (unsigned int) vals[i]->v.intV ^ 0x80000000u;
+			} else {
+				memcpy(&bits, &vals[i]->v.floatV, sizeof(float));
+				bits = (bits & 0x80000000u) ? ~bits : bits ^ 0x80000000u;
+			}
+			out[offset] = bits >> 24;
+			out[offset + 1] = bits >> 16;
+			out[offset + 2] = bits >> 8;
+			out[offset + 3] = bits;
+			break;
+		case DT_BOOL:
+			out[offset] = vals[i]->v.boolV ? 1 : 0;
+			break;
+		case DT_STRING:
+			// no need to read an over-long value to its end
+			if (strnlen(vals[i]->v.stringV, width + 1) > (size_t) width) {
+				return RC_IM_N_TO_LAGE;
+			}
+			memset(out + offset, 0, width);
+			strncpy((char *) out + offset, vals[i]->v.stringV, width);
+			break;
 		}
-		node = NULL;
+		offset += width;
+	}
+	if (len != NULL) {
+		*len = offset;
 	}
+	memset(out + offset, pad, desc->size - offset);
 	return RC_OK;
 }
 
+/*
+ * The key description follows the fixed header fields on page 0: the
+ * number of key columns, then type and length for each one.
+ */
+RC writeKeyDesc(char *data, int numAttr, DataType *dataTypes, int *typeLength) {
+	int i;
 
-RC createNew(Btree *root, Value* key, RID rid) {
-
-	root->is_leaf = true;
-	root->keys[0] = key->v.intV;
-	root->records[0] = rid;
-	root->parent = NULL;
-	root->num_keys++;
+	memmove(data, &numAttr, sizeof(int));
+	data = data + sizeof(int);
+	for (i = 0; i < numAttr; i++) {
+		memmove(data, &dataTypes[i], sizeof(int));
+		data = data + sizeof(int);
+		memmove(data, &typeLength[i], sizeof(int));
+		data = data + sizeof(int);
+	}
 	return RC_OK;
+}
 
+int keyDescSize(Btree_key *desc) {
+	return (1 + 2 * desc->numAttr) * sizeof(int);
 }
 
-RC createBtree(char* idxId, DataType keyType, int n) {
+Btree_key* readKeyDesc(char *data) {
+	Btree_key *desc = (Btree_key *) malloc(sizeof(Btree_key));
+	int i;
+
+	memcpy(&desc->numAttr, data, sizeof(int));
+	data = data + sizeof(int);
+	desc->size = 0;
+	desc->dataTypes = (DataType *) malloc(desc->numAttr * sizeof(DataType));
+	desc->typeLength = (int *) malloc(desc->numAttr * sizeof(int));
+	for (i = 0; i < desc->numAttr; i++) {
+		memcpy(&desc->dataTypes[i], data, sizeof(int));
+		data = data + sizeof(int);
+		memcpy(&desc->typeLength[i], data, sizeof(int));
+		data = data + sizeof(int);
+		desc->size += keyWidth(desc->dataTypes[i], desc->typeLength[i]);
+	}
+	return desc;
+}
+
+RC create_index_file(char *idxId, int n, int numAttr, DataType *dataTypes,
+		int *typeLength) {
 
 	BM_BufferPool *bm = MAKE_POOL();
 	BM_PageHandle *bh = MAKE_PAGE_HANDLE();
@@ -349,7 +504,8 @@ RC createBtree(char* idxId, DataType keyType, int n) {
 	initBufferPool(bm, idxId, 3, RS_FIFO, NULL);
 
 	pinPage(bm, bh, 0);
-	update(bh->data, keyType, n, 0, 0);
+	update(bh->data, dataTypes[0], n, 0, 0);
+	writeKeyDesc(bh->data + 6 * sizeof(int), numAttr, dataTypes, typeLength);
 	markDirty(bm, bh);
 	unpinPage(bm, bh);
 
@@ -357,10 +513,106 @@ RC createBtree(char* idxId, DataType keyType, int n) {
 
 	shutdownBufferPool(bm);
 	free(bm);
+	free(bh);
+
+	return RC_OK;
+}
+
+RC createBtree(char* idxId, DataType keyType, int n) {
+	int length = (keyType == DT_STRING) ? STRING_KEY_LENGTH : 0;
+
+	return create_index_file(idxId, n, 1, &keyType, &length);
+}
+
+/*
+ * Index on the key columns of schema (keyAttrs), in keyAttrs order.
+ */
+RC createCompositeBtree(char *idxId, int n, Schema *schema) {
+	DataType *dataTypes;
+	int *typeLength;
+	int i;
+	RC rc;
+
+	if (schema->keySize <= 0) {
+		return RC_NO_SUCH_ATTRIBUTE_IN_TABLE;
+	}
+	dataTypes = (DataType *) malloc(schema->keySize * sizeof(DataType));
+	typeLength = (int *) malloc(schema->keySize * sizeof(int));
+	for (i = 0; i < schema->keySize; i++) {
+		if (schema->keyAttrs[i] < 0 || schema->keyAttrs[i] >= schema->numAttr) {
+			free(dataTypes);
+			free(typeLength);
+			return RC_NO_SUCH_ATTRIBUTE_IN_TABLE;
+		}
+		dataTypes[i] = schema->dataTypes[schema->keyAttrs[i]];
+		typeLength[i] = schema->typeLength[schema->keyAttrs[i]];
+	}
+	rc = create_index_file(idxId, n, schema->keySize, dataTypes, typeLength);
+	free(dataTypes);
+	free(typeLength);
+	return rc;
+}
+
 
+/*
+ * Covered columns are described on the header page right after the
+ * order: the number of columns, then type, length and record offset for
+ * each one. Plain indexes store 0 there.
+ */
+RC writeCover(char *data, Schema *schema, int numCovered, int *coveredAttrs) {
+	int i, j, recOffset, attrNum;
+
+	memmove(data, &numCovered, sizeof(int));
+	data = data + sizeof(int);
+	for (i = 0; i < numCovered; i++) {
+		attrNum = coveredAttrs[i];
+		recOffset = 0;
+		for (j = 0; j < attrNum; j++) {
+			if (schema->dataTypes[j] == DT_INT)
+				recOffset += sizeof(int);
+			else if (schema->dataTypes[j] == DT_FLOAT)
+				recOffset += sizeof(float);
+			else if (schema->dataTypes[j] == DT_BOOL)
+				recOffset += sizeof(bool);
+			else
+				recOffset += schema->typeLength[j];
+		}
+		memmove(data, &schema->dataTypes[attrNum], sizeof(int));
+		data = data + sizeof(int);
+		memmove(data, &schema->typeLength[attrNum], sizeof(int));
+		data = data + sizeof(int);
+		memmove(data, &recOffset, sizeof(int));
+		data = data + sizeof(int);
+	}
 	return RC_OK;
 }
 
+Btree_cover* readCover(char *data) {
+	Btree_cover *cover;
+	int i, numCovered = 0;
+
+	memcpy(&numCovered, data, sizeof(int));
+	if (numCovered <= 0) {
+		return NULL;
+	}
+	data = data + sizeof(int);
+	cover = (Btree_cover *) malloc(sizeof(Btree_cover));
+	cover->numAttr = numCovered;
+	cover->size = 0;
+	cover->dataTypes = (DataType *) malloc(numCovered * sizeof(DataType));
+	cover->typeLength = (int *) malloc(numCovered * sizeof(int));
+	cover->offsets = (int *) malloc(numCovered * sizeof(int));
+	for (i = 0; i < numCovered; i++) {
+		memcpy(&cover->dataTypes[i], data, sizeof(int));
+		data = data + sizeof(int);
+		memcpy(&cover->typeLength[i], data, sizeof(int));
+		data = data + sizeof(int);
+		memcpy(&cover->offsets[i], data, sizeof(int));
+		data = data + sizeof(int);
+		cover->size += coverWidth(cover, i);
+	}
+	return cover;
+}
 
 RC openBtree(BTreeHandle** tree, char* idxId) {
 	unsigned int offset = 0, noblks = 0, noEntries = 0, rBlk = 0, key = -1,
@@ -384,23 +636,65 @@ RC openBtree(BTreeHandle** tree, char* idxId) {
 	memcpy(&rBlk, bh->data + offset, sizeof(int));
 	offset = offset + sizeof(int);
 	memcpy(&order, bh->data + offset, sizeof(int));
+	offset = offset + sizeof(int);
+	btStat->key = readKeyDesc(bh->data + offset);
+	offset = offset + keyDescSize(btStat->key);
+	btStat->cover = readCover(bh->data + offset);
 
-	unpinPage(bm, bh);
-
-	(*tree)->keyType = DT_INT;
+	(*tree)->keyType = btStat->key->dataTypes[0];
 	btStat->num_nodes = noblks;
 	btStat->num_inserts = noEntries;
 	btStat->order = order;
 	(*tree)->mgmtData = btStat;
 	btStat->fileInfo = bm;
+	btStat->header = bh;
+	btStat->freeNodes = NULL;
+	btStat->origin = NULL;
+	btStat->snapshots = 0;
+	btStat->openId = ++openCount;
 	btStat->mgmtData = createNode(*tree);
-	initialNode = btStat->mgmtData;
+	btStat->rightLeaf = btStat->mgmtData;
+	return RC_OK;
+}
+
 
+RC createCoveringBtree(char *idxId, DataType keyType, int n, Schema *schema,
+		int numCovered, int *coveredAttrs) {
+
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *bh = MAKE_PAGE_HANDLE();
+	Btree_key *desc;
+	int i;
+
+	for (i = 0; i < numCovered; i++) {
+		if (coveredAttrs[i] < 0 || coveredAttrs[i] >= schema->numAttr) {
+			free(bm);
+			free(bh);
+			return RC_NO_SUCH_ATTRIBUTE_IN_TABLE;
+		}
+	}
+	createBtree(idxId, keyType, n);
+	initBufferPool(bm, idxId, 3, RS_FIFO, NULL);
+
+	pinPage(bm, bh, 0);
+	desc = readKeyDesc(bh->data + 6 * sizeof(int));
+	writeCover(bh->data + 6 * sizeof(int) + keyDescSize(desc), schema,
+			numCovered, coveredAttrs);
+	markDirty(bm, bh);
+	unpinPage(bm, bh);
+
+	forceFlushPool(bm);
+
+	shutdownBufferPool(bm);
+	free(bm);
 	free(bh);
+	free(desc->dataTypes);
+	free(desc->typeLength);
+	free(desc);
+
 	return RC_OK;
 }
 
-
 RC deleteBtree(char* idxId) {
 	destroyPageFile(idxId);
 	return RC_OK;
@@ -408,15 +702,76 @@ RC deleteBtree(char* idxId) {
 
 RC closeBtree(BTreeHandle *tree) {
 	Btree_stat *root;
+	Btree *node;
 	root = tree->mgmtData;
+	unpinPage(root->fileInfo, root->header);
+	free(root->header);
 	shutdownBufferPool(root->fileInfo);
 	free(root->fileInfo);
-	free(root->mgmtData);
+	// the whole tree goes to the free list, except nodes an open
+	// snapshot still shares
+	release_node(root, root->mgmtData);
+	while (root->freeNodes != NULL) {
+		node = root->freeNodes;
+		root->freeNodes = node->next;
+		free(node->keys);
+		free(node->records);
+		free(node->pointers);
+		free(node->payloads);
+		free(node);
+	}
+	if (root->cover != NULL) {
+		free(root->cover->dataTypes);
+		free(root->cover->typeLength);
+		free(root->cover->offsets);
+		free(root->cover);
+	}
+	free(root->key->dataTypes);
+	free(root->key->typeLength);
+	free(root->key);
+	free(root);
 	tree->idxId = NULL;
 	free(tree);
 	return RC_OK;
 }
 
+/*
+ * A snapshot is a second handle on the current root. Both sides only
+ * read shared nodes; the live tree copies a node (see cow_node) before
+ * changing it, so the snapshot keeps seeing the tree as it was.
+ */
+RC snapshotBtree(BTreeHandle *tree, BTreeHandle **snapshot) {
+	Btree_stat *stat = tree->mgmtData;
+	Btree_stat *view = (Btree_stat *) malloc(sizeof(Btree_stat));
+	Btree *root = stat->mgmtData;
+
+	*view = *stat;
+	view->origin = (stat->origin == NULL) ? stat : stat->origin;
+	view->freeNodes = NULL;
+	view->snapshots = 0;
+	root->refs++;
+	view->origin->snapshots++;
+
+	(*snapshot) = (BTreeHandle *) malloc(sizeof(BTreeHandle));
+	(*snapshot)->keyType = tree->keyType;
+	(*snapshot)->idxId = tree->idxId;
+	(*snapshot)->mgmtData = view;
+	return RC_OK;
+}
+
+RC closeSnapshot(BTreeHandle *snapshot) {
+	Btree_stat *view = snapshot->mgmtData;
+
+	if (view->origin == NULL) {
+		return RC_NOT_OK;
+	}
+	release_node(view->origin, view->mgmtData);
+	view->origin->snapshots--;
+	free(view);
+	free(snapshot);
+	return RC_OK;
+}
+
 RC getNumNodes(BTreeHandle *tree, int *result) {
 	Btree_stat *root;
 	root = tree->mgmtData;
@@ -434,63 +789,110 @@ RC getNumEntries(BTreeHandle *tree, int *result) {
 
 
 RC getKeyType(BTreeHandle *tree, DataType *result) {
-	*result = DT_INT;
+	Btree_stat *root = tree->mgmtData;
+	*result = root->key->dataTypes[0];
 	return RC_OK;
 }
 
+RC getKeySize(BTreeHandle *tree, int *result) {
+	Btree_stat *root = tree->mgmtData;
+	*result = root->key->size;
+	return RC_OK;
+}
+
+RC encodeKey(BTreeHandle *tree, Value **key, char *result) {
+	Btree_stat *root = tree->mgmtData;
+	return encode_key(root->key, key, root->key->numAttr, result, 0, NULL);
+}
+
+/*
+ * Scan state for a scan starting at the first entry >= low; the caller
+ * places it with seek_leaf. The scan takes ownership of high, the upper
+ * bound of a range scan (NULL for none).
+ */
+Scankey* new_scankey(Btree_stat *stat, char *low, char *high, int highLen) {
+	Scankey *keydata = (Scankey *) malloc(sizeof(Scankey));
+
+	keydata->upper = malloc(stat->key->size);
+	keydata->seekKey = malloc(stat->key->size);
+	memcpy(keydata->seekKey, low, stat->key->size);
+	keydata->inclusive = true;
+	keydata->highKey = high;
+	keydata->highLen = highLen;
+	return keydata;
+}
+
 RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
 	Scankey *keydata = NULL;
 	Btree_stat *treeStat;
-	Btree *node;
 	treeStat = tree->mgmtData;
-	node = treeStat->mgmtData;
-	while (node->pointers[0] != NULL) {
-		node = node->pointers[0];
-	}
+	char low[treeStat->key->size];
 
 	(*handle) = (BT_ScanHandle *) malloc(sizeof(BT_ScanHandle));
 	if (*handle == NULL)
 		return RC_NOT_OK;
-	keydata = (Scankey *) malloc(sizeof(Scankey));
-	keydata->currentNode = node;
-	keydata->recnumber = 0;
+	memset(low, 0, treeStat->key->size);
+	keydata = new_scankey(treeStat, low, NULL, 0);
+	keydata->currentNode = seek_leaf(treeStat, keydata, &keydata->recnumber);
 	(*handle)->tree = tree;
 	(*handle)->mgmtData = (void *) keydata;
 	return RC_OK;
 }
 
-RC insertKey(BTreeHandle* tree, Value* key, RID rid) {
-	Btree *node, *temp1;
+/*
+ * Shared insert path. payload is the covered column data for the entry
+ * (NULL for plain indexes); the leaf takes ownership of it.
+ */
+RC insert_entry(BTreeHandle* tree, char *key, RID rid, char *payload) {
+	Btree *node;
 	Btree_stat *root;
 	int i;
 	root = tree->mgmtData;
+	if (root->origin != NULL) {
+		free(payload);
+		return RC_IM_READ_ONLY;
+	}
 	node = root->mgmtData;
 	if (root->num_nodes == 0) {
 		root->num_nodes++;
-		createNew(node, key, rid);
+		node = cow_node(tree, node);
+		createNew(node, key, rid, payload);
 		root->num_inserts++;
 		updateStat(tree, root);
 		return RC_OK;
 	}
-	node = find_node_to_insert(root, key);
-	temp1 = initialNode;
-	while (temp1 != NULL) {
-		for (i = 0; i < temp1->num_keys; i++) {
-			if (temp1->keys[i] == key->v.intV) {
-				updateStat(tree, root);
-				return RC_OK;
-			}
+	node = right_edge_leaf(root, key);
+	if (node != NULL) {
+		node = cow_node(tree, node);
+		if (node->num_keys < root->order) {
+			memcpy(KEY(node, node->num_keys), key, node->keySize);
+			node->records[node->num_keys] = rid;
+			node->payloads[node->num_keys] = payload;
+			node->num_keys++;
+		} else {
+			append_new_leaf(tree, root, node, key, rid, payload);
+		}
+		root->num_inserts++;
+		updateStat(tree, root);
+		return RC_OK;
+	}
+	node = find_leaf(tree, key);
+	for (i = 0; i < node->num_keys; i++) {
+		if (memcmp(KEY(node, i), key, node->keySize) == 0) {
+			free(payload);
+			updateStat(tree, root);
+			return RC_OK;
 		}
-		temp1 = temp1->next;
 	}
+	node = cow_node(tree, node);
 	if (node->num_keys < root->order) {
-		insertLeaf(node, key, rid);
+		insertLeaf(node, key, rid, payload);
 		root->num_inserts++;
 		updateStat(tree, root);
 		return RC_OK;
 	}
 	if (node->num_keys == root->order) {
-		Split_and_insert(tree, root, node, key, rid);
+		Split_and_insert(tree, root, node, key, rid, payload);
 		root->num_inserts++;
 		updateStat(tree, root);
 		return RC_OK;
@@ -498,131 +900,688 @@ RC insertKey(BTreeHandle* tree, Value* key, RID rid) {
 	return RC_OK;
 }
 
-RC closeTreeScan(BT_ScanHandle* handle) {
-	free(handle->mgmtData);
-	free(handle->tree);
-	return RC_OK;
-}
+RC insertKey(BTreeHandle* tree, Value* key, RID rid) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
 
-RC find_insert_after_redistribute(Btree *root, int key, RID *rid) {
-	int index = 0, i = 0;
-	while (index < root->num_keys && root->keys[index] < key) {
-		index++; //find index such that it is less than order and value must be greater than other elements
+	if ((rc = encode_key(root->key, &key, 1, buf, 0, NULL)) != RC_OK) {
+		return rc;
 	}
-	for (i = root->num_keys; i > index; i--) {
-		root->keys[i] = root->keys[i - 1];
-		root->records[i] = root->records[i - 1];
-	}
-	root->keys[index] = key;
-	root->records[index] = *rid;
-	root->num_keys++;
-	return RC_OK;
+	return insert_entry(tree, buf, rid, NULL);
 }
 
+RC insertCompositeKey(BTreeHandle *tree, Value **key, RID rid) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
 
-
-
-RC redistribute(Btree_stat *stat, Btree *left_node, Btree *right_node) {
-	int index = 0;
-	int key;
-	RID *rid = NULL;
-	index = left_node->num_keys - 1;
-	key = left_node->keys[index];
-	*rid = left_node->records[index];
-	left_node->keys[index] = NULL;
-	left_node->records[index].page = 0;
-	left_node->records[index].slot = 0;
-	left_node->num_keys--;
-	find_insert_after_redistribute(right_node, key, rid);
-	update_parent_node(right_node, key);
-	return RC_OK;
+	rc = encode_key(root->key, key, root->key->numAttr, buf, 0, NULL);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	return insert_entry(tree, buf, rid, NULL);
 }
 
-RC delete_parent_nodes_inital(Btree_stat *stat, Btree *node, Value *key) {
-	int i = 0, j;
-	if (node != NULL) {
-		while (node->keys[i] != key->v.intV) {
-			i++;
-		}
-		if (node->num_keys > 1) {
-			for (j = i; j < node->num_keys - 1; j++) {
-				node->keys[j] = node->keys[j + 1];
-				node->records[j] = node->records[j + 1];
-				node->pointers[j + 1] = node->pointers[j + 2];
+RC upsertKey(BTreeHandle *tree, Value *value, RID rid, RID *oldRid,
+		bool *existed) {
+	Btree *node;
+	Btree_stat *root;
+	int i;
+	root = tree->mgmtData;
+	char key[root->key->size];
+	RC rc;
+	if (existed != NULL) {
+		*existed = false;
+	}
+	if (root->origin != NULL) {
+		return RC_IM_READ_ONLY;
+	}
+	if ((rc = encode_key(root->key, &value, 1, key, 0, NULL)) != RC_OK) {
+		return rc;
+	}
+	if (root->num_nodes == 0) {
+		return insert_entry(tree, key, rid, NULL);
+	}
+
+	// single descent; an existing entry is overwritten without touching the structure
+	node = find_leaf(tree, key);
+	for (i = 0; i < node->num_keys; i++) {
+		if (memcmp(KEY(node, i), key, node->keySize) == 0) {
+			if (oldRid != NULL) {
+				*oldRid = node->records[i];
 			}
-			node->num_keys--;
-		} else {
-			node->keys[i] = NULL;
-			node->records[i].slot = 0;
-			node->records[i].page = 0;
-			node->pointers[i + 1] = NULL;
-			if (node->num_keys != 0) {
-				merge_nodes(stat, node->prev, node);
+			if (existed != NULL) {
+				*existed = true;
 			}
+			node = cow_node(tree, node);
+			node->records[i] = rid;
+			return RC_OK;
 		}
-		delete_parent_nodes_inital(stat, node->parent, key);
 	}
+	node = cow_node(tree, node);
+	if (node->num_keys < root->order) {
+		insertLeaf(node, key, rid, NULL);
+	} else if (node == right_edge_leaf(root, key)) {
+		append_new_leaf(tree, root, node, key, rid, NULL);
+	} else {
+		Split_and_insert(tree, root, node, key, rid, NULL);
+	}
+	root->num_inserts++;
+	updateStat(tree, root);
 	return RC_OK;
 }
 
-RC update_parent_nodes_inital(Btree *child, Value *key) {
-	Btree *parent;
-	int i = 0;
-	parent = child->parent;
-	if (parent != NULL) {
-		for (i = 0; i < parent->num_keys; i++) {
-			if (parent->keys[i] == key->v.intV) {
-				parent->keys[i] = child->keys[0];
+int compareEntries(const void *a, const void *b) {
+	const Btree_entry *left = a;
+	const Btree_entry *right = b;
+	int cmp = memcmp(left->key, right->key, left->size);
+
+	// keys are encoded in input order, so equal keys keep that order
+	if (cmp == 0) {
+		return (left->key > right->key) - (left->key < right->key);
+	}
+	return cmp;
+}
+
+/*
+ * Descend to the leaf that owns key. If bounded is set on return, every
+ * key >= upper belongs to a leaf further right.
+ */
+Btree* find_leaf_bounded(Btree_stat *stat, char *key, char *upper,
+		bool *bounded) {
+	Btree *node = stat->mgmtData;
+	int i;
+	*bounded = false;
+	while (node->is_leaf == false) {
+		for (i = 0; i < node->num_keys; i++) {
+			if (memcmp(key, KEY(node, i), node->keySize) < 0) {
+				memcpy(upper, KEY(node, i), node->keySize);
+				*bounded = true;
+				break;
 			}
 		}
-		update_parent_nodes_inital(parent, key);
+		node = node->pointers[i];
 	}
-	return RC_OK;
+	return node;
 }
 
-
-RC deleteKey(BTreeHandle *tree, Value *key) {
-	Btree_stat *node;
-	node = tree->mgmtData;
-	Btree * key_leaf, *left_node;
-	key_leaf = find_leaf(tree, key);
-	left_node = key_leaf->prev;
-	if (key_leaf != NULL) {
-		if (key_leaf->prev == NULL) {
-			delete_entry(tree, key_leaf, key);
-			return RC_OK;
+/*
+ * Merge the sorted run entries[0..count) into leaf, then cut the result
+ * into as few leaves as will hold it. All new leaves are linked in and
+ * posted to the parent level here, so the leaf is only split once.
+ * Returns the number of entries that were not already in the leaf.
+ */
+int merge_into_leaf(BTreeHandle *tree, Btree_stat *stat, Btree *leaf,
+		Btree_entry *entries, int count) {
+	int total = 0, added = 0, i = 0, j = 0, k, chunks, size, cmp;
+	int width = leaf->keySize;
+	char *temp_array_keys;
+	RID *temp_array_pointers;
+	char **temp_array_payloads;
+	Btree *left_node, *new_node;
+
+	temp_array_keys = malloc((leaf->num_keys + count) * width);
+	temp_array_pointers = malloc((leaf->num_keys + count) * sizeof(RID));
+	temp_array_payloads = malloc((leaf->num_keys + count) * sizeof(char *));
+	while (i < leaf->num_keys || j < count) {
+		cmp = 0;
+		if (i < leaf->num_keys && j < count) {
+			cmp = memcmp(KEY(leaf, i), entries[j].key, width);
 		}
-		if (key_leaf->keys[0] == key->v.intV) {
-			delete_entry(tree, key_leaf, key);
-			if (key_leaf->num_keys == 0) {
-				left_node->next = key_leaf->next;
-				delete_parent_nodes_inital(node, key_leaf, key);
-				return RC_OK;
+		if (j == count || (i < leaf->num_keys && cmp <= 0)) {
+			if (j < count && cmp == 0) {
+				j++;
 			}
+			memcpy(temp_array_keys + total * width, KEY(leaf, i), width);
+			temp_array_pointers[total] = leaf->records[i];
+			temp_array_payloads[total] = leaf->payloads[i];
+			i++;
+		} else {
+			memcpy(temp_array_keys + total * width, entries[j].key, width);
+			temp_array_pointers[total] = entries[j].rid;
+			temp_array_payloads[total] = NULL;
+			j++;
+			added++;
+		}
+		total++;
+	}
 
-			update_parent_nodes_inital(key_leaf, key);
-			return RC_OK;
+	chunks = (total + stat->order - 1) / stat->order;
+	left_node = leaf;
+	for (k = 0, i = 0; k < chunks; k++) {
+		size = total / chunks + (k < total % chunks ? 1 : 0);
+		if (k == 0) {
+			new_node = leaf;
 		} else {
-			delete_entry(tree, key_leaf, key);
-			if (key_leaf != NULL) {
-				if (checkUnderflow(node, key_leaf) == true) {
-					if (left_node != NULL) {
-						if (left_node->num_keys > splitNode(node->order)
-								&& left_node->num_keys != node->order) {
-							redistribute(node, left_node, key_leaf);
-						} else {
-							merge_nodes(node, left_node, key_leaf);
-						}
-					}
+			new_node = createNode(tree);
+			stat->num_nodes++;
+			new_node->next = left_node->next;
+			if (left_node->next != NULL) {
+				left_node->next->prev = new_node;
+			}
+			left_node->next = new_node;
+			new_node->prev = left_node;
+			new_node->parent = left_node->parent;
+		}
+		for (j = 0; j < size; j++, i++) {
+			memcpy(KEY(new_node, j), temp_array_keys + i * width, width);
+			new_node->records[j] = temp_array_pointers[i];
+			new_node->payloads[j] = temp_array_payloads[i];
+		}
+		new_node->num_keys = size;
+		if (k > 0) {
+			insert_parent(tree, stat, left_node, new_node, KEY(new_node, 0));
+			if (stat->rightLeaf == left_node) {
+				stat->rightLeaf = new_node;
+			}
+		}
+		left_node = new_node;
+	}
+
+	free(temp_array_keys);
+	free(temp_array_pointers);
+	free(temp_array_payloads);
+	return added;
+}
+
+RC insertKeys(BTreeHandle *tree, Value **keys, RID *rids, int n) {
+	Btree_stat *root;
+	Btree *leaf;
+	Btree_entry *entries;
+	char *encoded;
+	int i, unique, start, end, size;
+	bool bounded;
+	RC rc;
+
+	root = tree->mgmtData;
+	if (root->origin != NULL) {
+		return RC_IM_READ_ONLY;
+	}
+	if (n <= 0) {
+		return RC_OK;
+	}
+	size = root->key->size;
+	char upper[size];
+
+	entries = malloc(n * sizeof(Btree_entry));
+	encoded = malloc(n * size);
+	for (i = 0; i < n; i++) {
+		entries[i].key = encoded + i * size;
+		entries[i].size = size;
+		entries[i].rid = rids[i];
+		rc = encode_key(root->key, &keys[i], 1, entries[i].key, 0, NULL);
+		if (rc != RC_OK) {
+			free(entries);
+			free(encoded);
+			return rc;
+		}
+	}
+	qsort(entries, n, sizeof(Btree_entry), compareEntries);
+
+	// drop duplicates inside the batch, the first one wins like insertKey
+	unique = 1;
+	for (i = 1; i < n; i++) {
+		if (memcmp(entries[i].key, entries[unique - 1].key, size) != 0) {
+			entries[unique++] = entries[i];
+		}
+	}
+
+	start = 0;
+	if (root->num_nodes == 0) {
+		root->num_nodes++;
+		createNew(cow_node(tree, root->mgmtData), entries[0].key,
+				entries[0].rid, NULL);
+		root->num_inserts++;
+		start = 1;
+	}
+
+	// one descent per target leaf, every key for that leaf applied at once
+	while (start < unique) {
+		leaf = find_leaf_bounded(root, entries[start].key, upper, &bounded);
+		end = start + 1;
+		while (end < unique && (bounded == false
+				|| memcmp(entries[end].key, upper, size) < 0)) {
+			end++;
+		}
+		root->num_inserts += merge_into_leaf(tree, root, cow_node(tree, leaf),
+				entries + start, end - start);
+		start = end;
+	}
+
+	free(entries);
+	free(encoded);
+	flushStat(tree, root);
+	return RC_OK;
+}
+
+/*
+ * Bottom-up build of an empty tree from entries sorted by key. Leaves
+ * are filled left to right and every inner level is built over the one
+ * below it, so no node is ever split. low[i] is the smallest key under
+ * the i-th node of the level being grouped.
+ */
+RC bulkLoadKeys(BTreeHandle *tree, Btree_entry *entries, int n) {
+	Btree_stat *stat = tree->mgmtData;
+	Btree **level, *node, *prev;
+	char **low;
+	int count, numNodes, unique, i, j, k, size;
+
+	if (stat->origin != NULL) {
+		return RC_IM_READ_ONLY;
+	}
+	if (stat->num_nodes != 0) {
+		return RC_IM_KEY_ALREADY_EXISTS;
+	}
+	if (n <= 0) {
+		return RC_OK;
+	}
+
+	unique = 1;
+	for (i = 1; i < n; i++) {
+		if (memcmp(entries[i].key, entries[unique - 1].key,
+				stat->key->size) != 0) {
+			entries[unique++] = entries[i];
+		}
+	}
+
+	count = (unique + stat->order - 1) / stat->order;
+	level = malloc(count * sizeof(Btree *));
+	low = malloc(count * sizeof(char *));
+	prev = NULL;
+	for (k = 0, i = 0; k < count; k++) {
+		size = unique / count + (k < unique % count ? 1 : 0);
+		node = (k == 0) ? cow_node(tree, stat->mgmtData) : createNode(tree);
+		for (j = 0; j < size; j++, i++) {
+			memcpy(KEY(node, j), entries[i].key, node->keySize);
+			node->records[j] = entries[i].rid;
+			node->payloads[j] = NULL;
+		}
+		node->num_keys = size;
+		node->prev = prev;
+		if (prev != NULL) {
+			prev->next = node;
+		}
+		prev = node;
+		level[k] = node;
+		low[k] = KEY(node, 0);
+	}
+	stat->rightLeaf = prev;
+	numNodes = count;
+
+	while (count > 1) {
+		int parents = (count + stat->order) / (stat->order + 1);
+		prev = NULL;
+		for (k = 0, i = 0; k < parents; k++) {
+			size = count / parents + (k < count % parents ? 1 : 0);
+			node = createNode(tree);
+			node->is_leaf = false;
+			for (j = 0; j < size; j++, i++) {
+				node->pointers[j] = level[i];
+				level[i]->parent = node;
+				if (j > 0) {
+					memcpy(KEY(node, j - 1), low[i], node->keySize);
 				}
 			}
-			return RC_OK;
+			node->num_keys = size - 1;
+			node->prev = prev;
+			if (prev != NULL) {
+				prev->next = node;
+			}
+			prev = node;
+			low[k] = low[i - size];
+			level[k] = node;
 		}
+		numNodes += parents;
+		count = parents;
 	}
+	stat->mgmtData = level[0];
+	stat->num_nodes = numNodes;
+	stat->num_inserts = unique;
+
+	free(level);
+	free(low);
+	flushStat(tree, stat);
 	return RC_OK;
 }
 
-RC nextEntry(BT_ScanHandle *handle, RID *result) {
+RC closeTreeScan(BT_ScanHandle* handle) {
+	Scankey *keydata = handle->mgmtData;
+	free(keydata->highKey);
+	free(keydata->upper);
+	free(keydata->seekKey);
+	free(handle->mgmtData);
+	free(handle);
+	return RC_OK;
+}
+
+/*
+ * Copy the place of a scan so it can be picked up after the handle is
+ * closed. The position keeps the last key returned, and the leaf the
+ * scan stood on with its version for a cheap restore.
+ */
+RC saveScanPosition(BT_ScanHandle *handle, BT_ScanPosition **position) {
+	Btree_stat *stat = handle->tree->mgmtData;
+	Scankey *keydata = handle->mgmtData;
+	Scankey *saved = (Scankey *) malloc(sizeof(Scankey));
+
+	*saved = *keydata;
+	saved->seekKey = malloc(stat->key->size);
+	memcpy(saved->seekKey, keydata->seekKey, stat->key->size);
+	saved->upper = malloc(stat->key->size);
+	memcpy(saved->upper, keydata->upper, stat->key->size);
+	if (keydata->highKey != NULL) {
+		saved->highKey = malloc(stat->key->size);
+		memcpy(saved->highKey, keydata->highKey, stat->key->size);
+	}
+
+	(*position) = (BT_ScanPosition *) malloc(sizeof(BT_ScanPosition));
+	(*position)->tree = stat;
+	(*position)->openId = stat->openId;
+	(*position)->mgmtData = saved;
+	return RC_OK;
+}
+
+/*
+ * Open a scan that continues after the last key of a saved position.
+ * If the position was taken on this open tree, the saved leaf is reused
+ * and scan_next checks its version before trusting it; otherwise the
+ * scan descends to its place again.
+ */
+RC restoreScanPosition(BTreeHandle *tree, BT_ScanPosition *position,
+		BT_ScanHandle **handle) {
+	Btree_stat *stat = tree->mgmtData;
+	Scankey *saved = position->mgmtData;
+	Scankey *keydata;
+
+	keydata = new_scankey(stat, saved->seekKey, NULL, saved->highLen);
+	keydata->inclusive = saved->inclusive;
+	if (saved->highKey != NULL) {
+		keydata->highKey = malloc(stat->key->size);
+		memcpy(keydata->highKey, saved->highKey, stat->key->size);
+	}
+	if (position->tree == stat && position->openId == stat->openId
+			&& saved->currentNode != NULL) {
+		keydata->currentNode = saved->currentNode;
+		keydata->recnumber = saved->recnumber;
+		keydata->version = saved->version;
+		keydata->bounded = saved->bounded;
+		memcpy(keydata->upper, saved->upper, stat->key->size);
+	} else {
+		keydata->currentNode = seek_leaf(stat, keydata, &keydata->recnumber);
+	}
+
+	(*handle) = (BT_ScanHandle *) malloc(sizeof(BT_ScanHandle));
+	(*handle)->tree = tree;
+	(*handle)->mgmtData = (void *) keydata;
+	return RC_OK;
+}
+
+RC freeScanPosition(BT_ScanPosition *position) {
+	Scankey *saved = position->mgmtData;
+
+	free(saved->seekKey);
+	free(saved->upper);
+	free(saved->highKey);
+	free(saved);
+	free(position);
+	return RC_OK;
+}
+
+
+
+
+
+/*
+ * Detach child from its parent and hand it to the free list. The
+ * separator on the side of the removed child goes with it, so its key
+ * range folds into a neighbour. A parent left without children is
+ * removed the same way.
+ */
+RC remove_child(Btree_stat *stat, Btree *child) {
+	Btree *parent = child->parent;
+	int index = 0, i;
+
+	if (child->prev != NULL) {
+		child->prev->next = child->next;
+	}
+	if (child->next != NULL) {
+		child->next->prev = child->prev;
+	}
+	child->version++;
+	child->next = stat->freeNodes;
+	stat->freeNodes = child;
+	stat->num_nodes--;
+
+	if (parent == NULL) {
+		return RC_OK;
+	}
+	while (index < parent->num_keys && parent->pointers[index] != child) {
+		index++;
+	}
+	if (parent->num_keys == 0) {
+		return remove_child(stat, parent);
+	}
+	if (index > 0) {
+		for (i = index - 1; i < parent->num_keys - 1; i++) {
+			memcpy(KEY(parent, i), KEY(parent, i + 1), parent->keySize);
+		}
+	} else {
+		for (i = 0; i < parent->num_keys - 1; i++) {
+			memcpy(KEY(parent, i), KEY(parent, i + 1), parent->keySize);
+		}
+	}
+	for (i = index; i < parent->num_keys; i++) {
+		parent->pointers[i] = parent->pointers[i + 1];
+	}
+	parent->pointers[parent->num_keys] = NULL;
+	parent->num_keys--;
+	return RC_OK;
+}
+
+/*
+ * Drop inner levels that were left with a single child. An empty root
+ * leaf marks the tree as empty again.
+ */
+RC collapse_root(Btree_stat *stat) {
+	Btree *root, *next;
+
+	root = stat->mgmtData;
+	while (root->is_leaf == false && root->num_keys == 0) {
+		next = root->pointers[0];
+		root->parent = NULL;
+		remove_child(stat, root);
+		next->parent = NULL;
+		root = next;
+	}
+	stat->mgmtData = root;
+	if (root->is_leaf == true && root->num_keys == 0) {
+		stat->num_nodes = 0;
+		stat->rightLeaf = root;
+	}
+	return RC_OK;
+}
+
+/*
+ * Remove key from its leaf. Leaves are not rebalanced on underflow; a
+ * leaf that runs empty is unlinked like in deleteRange and its key range
+ * folds into a neighbour.
+ */
+RC delete_key(BTreeHandle *tree, char *key) {
+	Btree_stat *stat = tree->mgmtData;
+	Btree *leaf;
+	int i = 0;
+
+	if (stat->origin != NULL) {
+		return RC_IM_READ_ONLY;
+	}
+	if (stat->num_nodes == 0) {
+		return RC_IM_KEY_NOT_FOUND;
+	}
+	leaf = find_leaf(tree, key);
+	while (i < leaf->num_keys && memcmp(KEY(leaf, i), key, leaf->keySize) != 0) {
+		i++;
+	}
+	if (i == leaf->num_keys) {
+		return RC_IM_KEY_NOT_FOUND;
+	}
+	leaf = cow_node(tree, leaf);
+	free(leaf->payloads[i]);
+	for (; i < leaf->num_keys - 1; i++) {
+		memcpy(KEY(leaf, i), KEY(leaf, i + 1), leaf->keySize);
+		leaf->records[i] = leaf->records[i + 1];
+		leaf->payloads[i] = leaf->payloads[i + 1];
+	}
+	leaf->payloads[i] = NULL;
+	leaf->num_keys--;
+
+	if (leaf->num_keys == 0 && (leaf->prev != NULL || leaf->next != NULL)) {
+		if (stat->rightLeaf == leaf) {
+			stat->rightLeaf = leaf->prev;
+		}
+		remove_child(stat, leaf);
+	}
+	collapse_root(stat);
+	stat->num_inserts--;
+	flushStat(tree, stat);
+	return RC_OK;
+}
+
+RC deleteKey(BTreeHandle *tree, Value *key) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
+
+	if ((rc = encode_key(root->key, &key, 1, buf, 0, NULL)) != RC_OK) {
+		return rc;
+	}
+	return delete_key(tree, buf);
+}
+
+RC deleteCompositeKey(BTreeHandle *tree, Value **key) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
+
+	rc = encode_key(root->key, key, root->key->numAttr, buf, 0, NULL);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	return delete_key(tree, buf);
+}
+
+RC deleteRange(BTreeHandle *tree, Value *lo, Value *hi) {
+	Btree_stat *stat;
+	Btree *leaf, *next;
+	int i, j, first, last, removed = 0, size;
+	bool bounded, done = false;
+	RC rc;
+
+	stat = tree->mgmtData;
+	if (stat->origin != NULL) {
+		return RC_IM_READ_ONLY;
+	}
+	size = stat->key->size;
+	char upper[size], low[size], high[size];
+	if ((rc = encode_key(stat->key, &lo, 1, low, 0, NULL)) != RC_OK
+			|| (rc = encode_key(stat->key, &hi, 1, high, 0xff, NULL)) != RC_OK) {
+		return rc;
+	}
+	if (stat->num_nodes == 0 || memcmp(low, high, size) > 0) {
+		return RC_OK;
+	}
+
+	leaf = find_leaf_bounded(stat, low, upper, &bounded);
+	while (leaf != NULL && done == false) {
+		next = leaf->next;
+		first = 0;
+		while (first < leaf->num_keys
+				&& memcmp(KEY(leaf, first), low, size) < 0) {
+			first++;
+		}
+		last = first;
+		while (last < leaf->num_keys
+				&& memcmp(KEY(leaf, last), high, size) <= 0) {
+			last++;
+		}
+		if (last < leaf->num_keys) {
+			done = true;
+		}
+		if (last > first) {
+			leaf = cow_node(tree, leaf);
+		}
+		removed += last - first;
+		for (i = first; i < last; i++) {
+			free(leaf->payloads[i]);
+			leaf->payloads[i] = NULL;
+		}
+
+		if (first == 0 && last == leaf->num_keys
+				&& (leaf->prev != NULL || leaf->next != NULL)) {
+			// whole leaf is inside the range, unlink it without rebalancing
+			if (stat->rightLeaf == leaf) {
+				stat->rightLeaf = leaf->prev;
+			}
+			remove_child(stat, leaf);
+		} else {
+			for (i = first, j = last; j < leaf->num_keys; i++, j++) {
+				memcpy(KEY(leaf, i), KEY(leaf, j), size);
+				leaf->records[i] = leaf->records[j];
+				leaf->payloads[i] = leaf->payloads[j];
+			}
+			leaf->num_keys -= last - first;
+		}
+		leaf = next;
+	}
+
+	collapse_root(stat);
+	stat->num_inserts -= removed;
+	flushStat(tree, stat);
+	return RC_OK;
+}
+
+/*
+ * Leaf after the one a scan is on. The live tree follows the leaf chain.
+ * Sibling links in shared nodes belong to the live tree, so a snapshot
+ * descends again to the leaf bounded below by the current upper bound.
+ */
+Btree* next_leaf(Btree_stat *stat, Scankey *keydata, Btree *node) {
+	char key[stat->key->size];
+
+	if (stat->origin == NULL) {
+		return node->next;
+	}
+	if (keydata->bounded == false) {
+		return NULL;
+	}
+	memcpy(key, keydata->upper, stat->key->size);
+	return find_leaf_bounded(stat, key, keydata->upper, &keydata->bounded);
+}
+
+/*
+ * Descend to the place of a scan: the first entry at or after seekKey,
+ * or strictly after it once the scan has returned that key.
+ */
+Btree* seek_leaf(Btree_stat *stat, Scankey *keydata, int *numrec) {
+	Btree *leaf;
+	int i = 0, cmp;
+
+	leaf = find_leaf_bounded(stat, keydata->seekKey, keydata->upper,
+			&keydata->bounded);
+	while (i < leaf->num_keys) {
+		cmp = memcmp(KEY(leaf, i), keydata->seekKey, leaf->keySize);
+		if (cmp > 0 || (cmp == 0 && keydata->inclusive)) {
+			break;
+		}
+		i++;
+	}
+	*numrec = i;
+	keydata->version = leaf->version;
+	return (stat->num_nodes == 0) ? NULL : leaf;
+}
+
+RC scan_next(BT_ScanHandle *handle, RID *result, char **payload) {
+	Btree_stat *stat = handle->tree->mgmtData;
 	Btree *node;
 	int numrec;
 	Scankey *keydata = NULL;
@@ -630,48 +1589,160 @@ RC nextEntry(BT_ScanHandle *handle, RID *result) {
 	node = keydata->currentNode;
 	numrec = keydata->recnumber;
 
+	// the leaf was split, merged or reused since the last call
+	if (node != NULL && node->version != keydata->version) {
+		node = seek_leaf(stat, keydata, &numrec);
+	}
+	// leaves emptied by deletes hold nothing to return
+	while (node != NULL && numrec >= node->num_keys) {
+		node = next_leaf(stat, keydata, node);
+		numrec = 0;
+	}
+	// range scans stop at the first key past the upper bound
+	if (node != NULL && keydata->highKey != NULL
+			&& memcmp(KEY(node, numrec), keydata->highKey, keydata->highLen) > 0) {
+		node = NULL;
+	}
 	if (node != NULL) {
-		if (node->num_keys > numrec) {
-			*result = node->records[numrec];
-			numrec++;
+		*result = node->records[numrec];
+		if (payload != NULL) {
+			*payload = node->payloads[numrec];
 		}
+		memcpy(keydata->seekKey, KEY(node, numrec), node->keySize);
+		keydata->inclusive = false;
+		numrec++;
 		if (numrec == node->num_keys) {
-			node = node->next;
+			node = next_leaf(stat, keydata, node);
 			numrec = 0;
 		}
 		keydata->currentNode = node;
 		keydata->recnumber = numrec;
-		if (result == NULL) {
-			return RC_IM_NO_MORE_ENTRIES;
+		if (node != NULL) {
+			keydata->version = node->version;
 		}
 		return RC_OK;
 	} else {
+		keydata->currentNode = NULL;
 		return RC_IM_NO_MORE_ENTRIES;
 	}
 }
 
-RC findKey(BTreeHandle *tree, Value *key, RID *result) {
+RC nextEntry(BT_ScanHandle *handle, RID *result) {
+	return scan_next(handle, result, NULL);
+}
 
-	Btree *root, *temp1;
-	Btree_stat *btstat;
-	btstat = tree->mgmtData;
-	root = btstat->mgmtData;
-	int i = 0;
-	root = btstat->mgmtData;
-	temp1 = root;
-	while (temp1->is_leaf == false) {
-		for (i = 0; i < root->num_keys; i++) {
-			if (key->v.intV < root->keys[i]) {
-				temp1 = root->pointers[i];
-				break;
-			} else {
-				temp1 = root->pointers[i + 1];
+/*
+ * Copy the covered columns of record into a new payload buffer laid
+ * out in cover order.
+ */
+char* build_payload(Btree_cover *cover, Record *record) {
+	char *payload = malloc(cover->size);
+	int i, offset = 0, width;
+
+	for (i = 0; i < cover->numAttr; i++) {
+		width = coverWidth(cover, i);
+		memcpy(payload + offset, record->data + cover->offsets[i], width);
+		offset += width;
+	}
+	return payload;
+}
+
+RC payload_values(Btree_cover *cover, char *payload, Value **values) {
+	int i, offset = 0, width;
+	Value *val;
+
+	for (i = 0; i < cover->numAttr; i++) {
+		width = coverWidth(cover, i);
+		val = (Value *) malloc(sizeof(Value));
+		val->dt = cover->dataTypes[i];
+		switch (cover->dataTypes[i]) {
+		case DT_INT:
+			memcpy(&val->v.intV, payload + offset, sizeof(int));
+			break;
+		case DT_FLOAT:
+			memcpy(&val->v.floatV, payload + offset, sizeof(float));
+			break;
+		case DT_BOOL:
+			memcpy(&val->v.boolV, payload + offset, sizeof(bool));
+			break;
+		case DT_STRING:
+			val->v.stringV = (char *) malloc(width + 1);
+			memcpy(val->v.stringV, payload + offset, width);
+			val->v.stringV[width] = '\0';
+			break;
+		}
+		values[i] = val;
+		offset += width;
+	}
+	return RC_OK;
+}
+
+RC insertCoveringKey(BTreeHandle *tree, Value *key, RID rid, Record *record) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
+
+	if ((rc = encode_key(root->key, &key, 1, buf, 0, NULL)) != RC_OK) {
+		return rc;
+	}
+	if (root->cover == NULL) {
+		return insert_entry(tree, buf, rid, NULL);
+	}
+	return insert_entry(tree, buf, rid, build_payload(root->cover, record));
+}
+
+RC getNumCoveredAttrs(BTreeHandle *tree, int *result) {
+	Btree_stat *root = tree->mgmtData;
+	*result = (root->cover == NULL) ? 0 : root->cover->numAttr;
+	return RC_OK;
+}
+
+RC nextCoveringEntry(BT_ScanHandle *handle, RID *result, Value **values) {
+	Btree_stat *root = handle->tree->mgmtData;
+	char *payload = NULL;
+	RC rc;
+
+	rc = scan_next(handle, result, &payload);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	if (root->cover == NULL || payload == NULL) {
+		return RC_IM_NO_PAYLOAD;
+	}
+	return payload_values(root->cover, payload, values);
+}
+
+RC findCoveringKey(BTreeHandle *tree, Value *key, RID *result, Value **values) {
+	Btree_stat *root = tree->mgmtData;
+	Btree *leaf;
+	char buf[root->key->size];
+	int i;
+	RC rc;
+
+	if ((rc = encode_key(root->key, &key, 1, buf, 0, NULL)) != RC_OK) {
+		return rc;
+	}
+	leaf = find_leaf(tree, buf);
+	for (i = 0; i < leaf->num_keys; i++) {
+		if (memcmp(KEY(leaf, i), buf, leaf->keySize) == 0) {
+			*result = leaf->records[i];
+			if (root->cover == NULL || leaf->payloads[i] == NULL) {
+				return RC_IM_NO_PAYLOAD;
 			}
+			return payload_values(root->cover, leaf->payloads[i], values);
 		}
 	}
+	return RC_IM_KEY_NOT_FOUND;
+}
 
+RC find_key(BTreeHandle *tree, char *key, RID *result) {
+
+	Btree *temp1;
+	int i = 0;
+
+	temp1 = find_leaf(tree, key);
 	for (i = 0; i < temp1->num_keys; i++) {
-		if (temp1->keys[i] == key->v.intV) {
+		if (memcmp(KEY(temp1, i), key, temp1->keySize) == 0) {
 			*result = temp1->records[i];
 			return RC_OK;
 		}
@@ -679,6 +1750,77 @@ RC findKey(BTreeHandle *tree, Value *key, RID *result) {
 	return RC_IM_KEY_NOT_FOUND;
 }
 
+RC findKey(BTreeHandle *tree, Value *key, RID *result) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
+
+	if ((rc = encode_key(root->key, &key, 1, buf, 0, NULL)) != RC_OK) {
+		return rc;
+	}
+	return find_key(tree, buf, result);
+}
+
+RC findCompositeKey(BTreeHandle *tree, Value **key, RID *result) {
+	Btree_stat *root = tree->mgmtData;
+	char buf[root->key->size];
+	RC rc;
+
+	rc = encode_key(root->key, key, root->key->numAttr, buf, 0, NULL);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	return find_key(tree, buf, result);
+}
+
+/*
+ * Scan every entry whose first numCols key columns lie between lo and hi.
+ * lo is padded with 0x00 to the smallest full key with that prefix, so a
+ * single descent finds the first leaf; the scan stops at the first key
+ * whose prefix sorts after hi. A NULL lo or hi leaves that end open.
+ */
+RC openRangeScan(BTreeHandle *tree, Value **lo, Value **hi, int numCols,
+		BT_ScanHandle **handle) {
+	Btree_stat *root = tree->mgmtData;
+	Scankey *keydata;
+	char low[root->key->size];
+	char *high = NULL;
+	int len = 0;
+	RC rc;
+
+	rc = encode_key(root->key, lo, (lo == NULL) ? 0 : numCols, low, 0, NULL);
+	if (rc != RC_OK) {
+		return rc;
+	}
+	if (hi != NULL) {
+		high = malloc(root->key->size);
+		if ((rc = encode_key(root->key, hi, numCols, high, 0, &len)) != RC_OK) {
+			free(high);
+			return rc;
+		}
+	}
+	keydata = new_scankey(root, low, high, len);
+	keydata->currentNode = seek_leaf(root, keydata, &keydata->recnumber);
+	(*handle) = (BT_ScanHandle *) malloc(sizeof(BT_ScanHandle));
+	(*handle)->tree = tree;
+	(*handle)->mgmtData = (void *) keydata;
+	return RC_OK;
+}
+
+RC openPrefixScan(BTreeHandle *tree, Value **prefix, int numCols,
+		BT_ScanHandle **handle) {
+	return openRangeScan(tree, prefix, prefix, numCols, handle);
+}
+
+void printKey(Btree *node, int i) {
+	int j;
+
+	printf(" ");
+	for (j = 0; j < node->keySize; j++) {
+		printf("%02x", (unsigned char) KEY(node, i)[j]);
+	}
+}
+
 RC print(BTreeHandle* tree) {
 
 	Btree *root;
@@ -689,7 +1831,7 @@ RC print(BTreeHandle* tree) {
 
 	while (root != NULL) {
 		for (i = 0; i < root->num_keys; i++) {
-			printf(" %d", root->keys[i]);
+			printKey(root, i);
 		}
 		printf("\t");
 		root = root->next;
@@ -702,7 +1844,7 @@ RC print(BTreeHandle* tree) {
 	while (root != NULL) {
 		i = 0;
 		while (i < root->num_keys) {
-			printf(" %d", root->keys[i]);
+			printKey(root, i);
 			i++;
 		}
 		printf("\t");
@@ -714,9 +1856,6 @@ RC print(BTreeHandle* tree) {
 
 
 
-
-
-
 RC update(char *data, DataType keyType, int n, int noNodes, int type) {
 	unsigned int offset = 0, noblks = 0, noEntries = 0, curBlk = 0, rBlk = 0;
 	unsigned int key = -1;
@@ -768,174 +1907,149 @@ RC Readtree(BTreeHandle** tree, char *data) {
 
 
 
-
-RC insertParent(Btree *root, int key) {
+RC insertParent(Btree *root, Btree *old_node, Btree *new_node, char *key) {
 
 	int index = 0, i = 0;
 
-	while (index < root->num_keys && root->keys[index] < key) {
+	while (index <= root->num_keys && root->pointers[index] != old_node) {
 		index++;
 	}
 
 	for (i = root->num_keys; i > index; i--) {
-		root->keys[i] = root->keys[i - 1];
-		root->records[i] = root->records[i - 1];
+		memcpy(KEY(root, i), KEY(root, i - 1), root->keySize);
+		root->pointers[i + 1] = root->pointers[i];
 	}
 
-	root->keys[index] = key;
-	root->records[index].page = 0;
-	root->records[index].slot = 0;
+	memcpy(KEY(root, index), key, root->keySize);
+	root->pointers[index + 1] = new_node;
 	root->num_keys++;
 	return RC_OK;
 
 }
 
-
-
-Btree* getParent(Btree *old_node, int new_key) {
-	Btree *node, *prev;
-	node = old_node->parent;
-	prev = node;
-	while (node != NULL) {
-		if (node->is_leaf == false) {
-			if (node->keys[0] > new_key) {
-				return prev;
-			}
-		}
-		prev = node;
-		node = node->next;
-	}
-	return prev;
-}
-
 RC insert_parent(BTreeHandle* tree, Btree_stat *root, Btree *old_node,
-		Btree *new_node, int new_key) {
+		Btree *new_node, char *new_key) {
 	Btree *parent_node;
 	if (old_node->parent == NULL) {
 		parent_node = createNode(tree);
 		root->num_nodes++;
+		parent_node->is_leaf = false;
+		memcpy(KEY(parent_node, 0), new_key, parent_node->keySize);
 		parent_node->pointers[0] = old_node;
 		parent_node->pointers[1] = new_node;
+		parent_node->num_keys = 1;
+		old_node->parent = parent_node;
+		new_node->parent = parent_node;
 		root->mgmtData = parent_node;
-	} else {
-		parent_node = getParent(old_node, new_key);
-		int k = parent_node->num_keys;
-		parent_node->pointers[k + 1] = new_node;
+		return RC_OK;
 	}
-	parent_node->is_leaf = false;
 
-	old_node->parent = parent_node;
+	parent_node = old_node->parent;
 	new_node->parent = parent_node;
 
 	if (parent_node->num_keys < root->order) {
-		int k = 0;
-		k = parent_node->num_keys + 1;
-		parent_node->pointers[k] = new_node;
-		insertParent(parent_node, new_key);
+		insertParent(parent_node, old_node, new_node, new_key);
 		return RC_OK;
 	}
 
-	if (parent_node->num_keys == root->order) {
-		insertRoot(tree, root, parent_node, new_key);
-		return RC_OK;
-	}
+	insertRoot(tree, root, parent_node, old_node, new_node, new_key);
 	return RC_OK;
 }
 
 
 
 RC insertRoot(BTreeHandle *tree, Btree_stat *root, Btree *old_node,
-		int key) {
+		Btree *left_child, Btree *right_child, char *key) {
 	Btree *new_node;
+	int index = 0, i = 0, j = 0;
+	char *temp_array_keys;
+	Btree **temp_array_pointers;
+	int split_pos, size = root->key->size;
+	char new_key[size];
+
 	new_node = createNode(tree);
 	root->num_nodes++;
 	new_node->is_leaf = false;
+	new_node->next = old_node->next;
+	if (old_node->next != NULL) {
+		old_node->next->prev = new_node;
+	}
 	old_node->next = new_node;
 	new_node->prev = old_node;
-	int index = 0, i = 0, j = 0;
-	int *temp_array_keys;
-	int split_pos, num_new_node = 0, new_key = 0;
-	temp_array_keys = malloc((root->order + 1) * sizeof(int));
-	while (index < old_node->num_keys && old_node->keys[index] < key) {
-		index++; //find index such that it is less than order and value must be greater than other elements
+	new_node->parent = old_node->parent;
+
+	temp_array_keys = malloc((root->order + 1) * size);
+	temp_array_pointers = malloc((root->order + 2) * sizeof(Btree *));
+	while (index <= old_node->num_keys
+			&& old_node->pointers[index] != left_child) {
+		index++;
 	}
-	do {
+	for (i = 0, j = 0; i < old_node->num_keys; i++, j++) {
 		if (j == index) {
 			j++;
 		}
-		temp_array_keys[j] = old_node->keys[i];
-		i++;
-		j++;
-	} while (i < old_node->num_keys);
-	temp_array_keys[index] = key;
-	split_pos = 1 + splitNode(root->order);
+		memcpy(temp_array_keys + j * size, KEY(old_node, i), size);
+	}
+	for (i = 0, j = 0; i <= old_node->num_keys; i++, j++) {
+		if (j == index + 1) {
+			j++;
+		}
+		temp_array_pointers[j] = old_node->pointers[i];
+	}
+	memcpy(temp_array_keys + index * size, key, size);
+	temp_array_pointers[index + 1] = right_child;
+
+	// the middle key moves up, the halves either side of it stay here
+	split_pos = (root->order + 1) / 2;
 	old_node->num_keys = 0;
-	j = 0;
-	for (i = 0; i < split_pos - 1; i++) {
-		old_node->keys[i] = temp_array_keys[i];
+	for (i = 0; i < split_pos; i++) {
+		memcpy(KEY(old_node, i), temp_array_keys + i * size, size);
+		old_node->pointers[i] = temp_array_pointers[i];
 		old_node->num_keys++;
-		j++;
 	}
-	j++;
-	new_key = temp_array_keys[split_pos - 1];
-	num_new_node = root->order + 1 - split_pos;
-	for (i = 0; i < num_new_node; i++) {
-		new_node->keys[i] = temp_array_keys[j];
+	old_node->pointers[split_pos] = temp_array_pointers[split_pos];
+	memcpy(new_key, temp_array_keys + split_pos * size, size);
+	for (i = 0, j = split_pos + 1; j <= root->order; i++, j++) {
+		memcpy(KEY(new_node, i), temp_array_keys + j * size, size);
+		new_node->pointers[i] = temp_array_pointers[j];
 		new_node->num_keys++;
-		j++;
 	}
-	root->mgmtData = new_node;
+	new_node->pointers[i] = temp_array_pointers[j];
+	for (i = 0; i <= new_node->num_keys; i++) {
+		new_node->pointers[i]->parent = new_node;
+	}
+	for (i = 0; i <= old_node->num_keys; i++) {
+		old_node->pointers[i]->parent = old_node;
+	}
+	free(temp_array_keys);
+	free(temp_array_pointers);
 	insert_parent(tree, root, old_node, new_node, new_key);
 	return RC_OK;
 }
 
 
 
-
-
-RC updateStat(BTreeHandle *bhandle, Btree_stat* stat) {
-	BM_PageHandle *bh = MAKE_PAGE_HANDLE();
-	pinPage(stat->fileInfo, bh, 0);
-	update(bh->data, bhandle->keyType, stat->order, stat->num_nodes, 2);
+/*
+ * Write the absolute node and entry counts to the header page. Used
+ * after batch operations that change many entries at once. The header
+ * stays pinned while the tree is open and reaches disk on closeBtree.
+ */
+RC flushStat(BTreeHandle *bhandle, Btree_stat* stat) {
+	unsigned int offset = sizeof(int);
+	BM_PageHandle *bh = stat->header;
+	memmove(bh->data + offset, &stat->num_nodes, sizeof(int));
+	offset = offset + sizeof(int);
+	memmove(bh->data + offset, &stat->num_inserts, sizeof(int));
 	markDirty(stat->fileInfo, bh);
-	unpinPage(stat->fileInfo, bh);
-	forceFlushPool(stat->fileInfo);
-	free(bh);
 	return RC_OK;
 }
 
-
-
-
-RC merge_nodes(Btree_stat *stat, Btree *left_node, Btree *right_node) {
-	int numleft, numright, index, i, j = 0;
-	if (left_node != NULL) {
-		numleft = stat->order - left_node->num_keys;
-		index = left_node->num_keys;
-		numright = right_node->num_keys;
-		if (numleft >= numright) {
-			for (i = index; i < numright + 1; i++) {
-				left_node->keys[i] = right_node->keys[j];
-				left_node->records[i] = right_node->records[j];
-				j++;
-			}
-			update_parent_nodes(right_node);
-			left_node->next = right_node->next;
-			right_node = NULL;
-		}
-	}
+RC updateStat(BTreeHandle *bhandle, Btree_stat* stat) {
+	BM_PageHandle *bh = stat->header;
+	update(bh->data, bhandle->keyType, stat->order, stat->num_nodes, 2);
+	markDirty(stat->fileInfo, bh);
 	return RC_OK;
 }
 
 
 
-
-
-
-
-
-
-
-
-
-
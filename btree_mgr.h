@@ -9,26 +9,69 @@
 typedef struct Scankey {
 	struct Btree *currentNode;
 	int recnumber;
+	unsigned int version;	// of currentNode when the scan stepped onto it
+	char *seekKey;	// last key returned, or the start key before that
+	bool inclusive;
+	char *highKey;
+	int highLen;
+	char *upper;
+	bool bounded;
 } Scankey;
 
 typedef struct Btree {
-	int *keys;
+	char *keys;
+	int keySize;
 	struct Btree *parent;
 	struct Btree **pointers;
 	RID *records;
+	char **payloads;
 	bool is_leaf;
 	int num_keys;
 	int blkNum;
+	unsigned int version;	// advanced on every change, scans use it to check their leaf
+	int refs;	// parents referring to the node, more than one once a snapshot shares it
 	struct Btree *next;
 	struct Btree *prev;
 } Btree;
 
+// key columns, encoded into one memcmp ordered byte string of size bytes
+typedef struct Btree_key {
+	int numAttr;
+	int size;
+	DataType *dataTypes;
+	int *typeLength;
+} Btree_key;
+
+// table columns carried in the leaf entries of a covering index
+typedef struct Btree_cover {
+	int numAttr;
+	int size;
+	DataType *dataTypes;
+	int *typeLength;
+	int *offsets;
+} Btree_cover;
+
+// one index entry: key encoded like the tree's own keys (see encodeKey)
+typedef struct Btree_entry {
+	char *key;
+	int size;
+	RID rid;
+} Btree_entry;
+
 typedef struct Btree_stat {
 	void *mgmtData;
 	void *fileInfo;
+	void *header;	// page 0, pinned for as long as the tree is open
 	int num_nodes;
 	int num_inserts;
 	int order;
+	Btree *rightLeaf;
+	Btree *freeNodes;
+	Btree_cover *cover;
+	Btree_key *key;
+	struct Btree_stat *origin;	// live tree of a snapshot, NULL for the live tree
+	int snapshots;
+	int openId;
 } Btree_stat;
 
 
@@ -44,28 +87,64 @@ typedef struct BT_ScanHandle {
   void *mgmtData;
 } BT_ScanHandle;
 
+// place of a scan that outlives the scan handle
+typedef struct BT_ScanPosition {
+  void *tree;
+  int openId;
+  void *mgmtData;
+} BT_ScanPosition;
+
 // init and shutdown index manager
 extern RC initIndexManager (void *mgmtData);
 extern RC shutdownIndexManager ();
 
 // create, destroy, open, and close an btree index
 extern RC createBtree (char *idxId, DataType keyType, int n);
+extern RC createCoveringBtree (char *idxId, DataType keyType, int n, Schema *schema, int numCovered, int *coveredAttrs);
+extern RC createCompositeBtree (char *idxId, int n, Schema *schema);
 extern RC openBtree (BTreeHandle **tree, char *idxId);
 extern RC closeBtree (BTreeHandle *tree);
 extern RC deleteBtree (char *idxId);
 
+// read-only views sharing nodes copy-on-write with the live tree
+extern RC snapshotBtree (BTreeHandle *tree, BTreeHandle **snapshot);
+extern RC closeSnapshot (BTreeHandle *snapshot);
+
 // access information about a b-tree
 extern RC getNumNodes (BTreeHandle *tree, int *result);
 extern RC getNumEntries (BTreeHandle *tree, int *result);
 extern RC getKeyType (BTreeHandle *tree, DataType *result);
+extern RC getNumCoveredAttrs (BTreeHandle *tree, int *result);
+extern RC getKeySize (BTreeHandle *tree, int *result);
 
 // index access
 extern RC findKey (BTreeHandle *tree, Value *key, RID *result);
 extern RC insertKey (BTreeHandle *tree, Value *key, RID rid);
+extern RC insertKeys (BTreeHandle *tree, Value **keys, RID *rids, int n);
+extern RC encodeKey (BTreeHandle *tree, Value **key, char *result);
+extern RC bulkLoadKeys (BTreeHandle *tree, Btree_entry *entries, int n);
+extern RC upsertKey (BTreeHandle *tree, Value *key, RID rid, RID *oldRid, bool *existed);
 extern RC deleteKey (BTreeHandle *tree, Value *key);
+extern RC deleteRange (BTreeHandle *tree, Value *lo, Value *hi);
 extern RC openTreeScan (BTreeHandle *tree, BT_ScanHandle **handle);
 extern RC nextEntry (BT_ScanHandle *handle, RID *result);
 extern RC closeTreeScan (BT_ScanHandle *handle);
+extern RC saveScanPosition (BT_ScanHandle *handle, BT_ScanPosition **position);
+extern RC restoreScanPosition (BTreeHandle *tree, BT_ScanPosition *position, BT_ScanHandle **handle);
+extern RC freeScanPosition (BT_ScanPosition *position);
+
+// covering index access, values receives one Value per covered column
+extern RC insertCoveringKey (BTreeHandle *tree, Value *key, RID rid, Record *record);
+extern RC findCoveringKey (BTreeHandle *tree, Value *key, RID *result, Value **values);
+extern RC nextCoveringEntry (BT_ScanHandle *handle, RID *result, Value **values);
+
+// composite index access, key holds one Value per key column of the schema
+// and prefix/range scans take the first numCols of them
+extern RC insertCompositeKey (BTreeHandle *tree, Value **key, RID rid);
+extern RC findCompositeKey (BTreeHandle *tree, Value **key, RID *result);
+extern RC deleteCompositeKey (BTreeHandle *tree, Value **key);
+extern RC openPrefixScan (BTreeHandle *tree, Value **prefix, int numCols, BT_ScanHandle **handle);
+extern RC openRangeScan (BTreeHandle *tree, Value **lo, Value **hi, int numCols, BT_ScanHandle **handle);
 
 // debug and test functions
 extern char *printTree (BTreeHandle *tree);
@@ -1,31 +1,93 @@
 // Standard C libraries
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
 #include<pthread.h>
+#include<time.h>
+#include<sys/mman.h>
+#include<limits.h>
 // Local libraries
 #include "buffer_mgr.h"
 
+// Arenas at least this large are aligned for transparent huge pages.
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+// RS_LRU_K keys of frames with K references start here, the rest go first.
+#define LRU_K_FULL ((long long) 1 << 48)
+// Pins one page further each that make a run worth reading ahead of.
+#define READ_AHEAD_RUN 2
+
 
 /****************Thread Safe extra credit**********************/
 
 /***** Description: Mutex locks allows only single thread to execute the critical 
  *                  section of the program by blocking all the other processes try to execute concurrently
+ *                  Each pool has its own lock for its frame table and replacement state, it is
+ *                  never held across disk I/O. Pin counts are atomic and pages have latches.
  *      
  *       Author: Anirudh Deshpande  (adeshp17@hawk.iit.edu)      */
 static pthread_mutex_t mutex_init = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t mutex_unpinPage = PTHREAD_MUTEX_INITIALIZER; 
-static pthread_mutex_t mutex_pinPage = PTHREAD_MUTEX_INITIALIZER;  
 
-int readCount = 0, writeCount = 0, hit = 0;
-pageListT *head = NULL;
+static void unswizzleFrame(pageListT *node);
+static RC readFrame(BM_BufferPool *const bm, pageListT *node, PageNumber pageNum);
+static int frameLookup(poolInfoT *pool, PageNumber pageNum);
+static void frameTableInsert(poolInfoT *pool, PageNumber pageNum, int frame);
+static void frameTableRemove(poolInfoT *pool, int entry);
+static void referenceFrame(poolInfoT *pool, pageListT *node);
+static void releaseFrame(BM_BufferPool *const bm, pageListT *node);
+static void heapRemove(poolInfoT *pool, pageListT *node);
+static RC evictHeapMin(BM_BufferPool *const bm, pageListT *pageT);
+static pageListT *pinnedFrame(poolInfoT *pool, BM_PageHandle *const page);
+static int tableFind(poolInfoT *pool, PageNumber pageNum);
+static int pageBusy(poolInfoT *pool, PageNumber pageNum);
+static void arcLink(poolInfoT *pool, int entry, int list);
+static void arcLinkLast(poolInfoT *pool, int entry, int list);
+static void arcUnlink(poolInfoT *pool, int entry);
+static int arcVictim(poolInfoT *pool, int list);
+static void ghostAdd(poolInfoT *pool, PageNumber pageNum, int list);
+static void ghostDrop(poolInfoT *pool, int entry);
+static RC claimFrame(BM_BufferPool *const bm, PageNumber pageNum, pageListT **frame);
+static RC loadFrame(BM_BufferPool *const bm, pageListT *node, PageNumber pageNum);
+static void readAhead(BM_BufferPool *const bm, PageNumber pageNum);
+static void stopPrefetcher(poolInfoT *pool);
 
 /***Replacement stratagies implementation****/
 
+/****************************************************************
+ * Function Name: replaceFrame 
+ * 
+ * Description: Hands a victim frame over to page pageNum: unswizzles
+ *              the references to it and moves it in the frame table. 
+ *              The caller writes the old page back if it is dirty and
+ *              reads the new page in, without the pool lock. Until then
+ *              the old page keeps a table entry, so it is not read 
+ *              before it is written.
+ * 
+ * Parameter: BM_BufferPool, pageListT, PageNumber
+ * 
+ * Return: void
+ ****************************************************************/
+static void replaceFrame(BM_BufferPool *const bm, pageListT *node, PageNumber pageNum){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    unswizzleFrame(node);
+    frameTableRemove(pool, node - pool->frames);
+    /* If the page is modified by the client, then write the page to disk*/
+    if(node->dirtyBit == 1){
+      node->writePage = node->pgNum;
+      frameTableInsert(pool, node->writePage, 2 * pool->numFrames + (node - pool->frames));
+    }
+    node->pgNum = pageNum;
+    frameTableInsert(pool, pageNum, node - pool->frames);
+    node->dirtyBit = 0;
+    node->prefetched = 0;
+}
+
 /****************************************************************
  * Function Name: FIFO 
  * 
  * Description: Page replacement strategy to replace page frames
- *               using first in first out algorithm.
+ *               using first in first out algorithm. The victim frame
+ *               takes over the page of pageT, the caller reads it in.
  * 
  * Parameter: BM_BufferPool, pageListT
  * 
@@ -38,39 +100,18 @@ extern RC FIF0(BM_BufferPool *const bm, pageListT *pageT){
     if(bm == NULL){
       return RC_BUFFER_POOL_NOT_INIT;
     }
-    pageListT *node = (pageListT *)bm->mgmtData;
-
-    while(node != NULL){
-        node = node->next;
-    }
-    node = (pageListT *)bm->mgmtData;
-    SM_FileHandle fHandle;
-    while(node != NULL){
-      if(node->fifoBit == 1){
-          if(node->fixCount == 0){
-             /* If the page is modified by the client, then write the page to disk*/
-             if(node->dirtyBit == 1)
-             {
-                openPageFile(bm->pageFile, &fHandle);
-                writeBlock(node->pgNum, &fHandle, node->data);
-                closePageFile(&fHandle);
-                writeCount++;
-             }
-             node->data = pageT->data;
-             node->pgNum = pageT->pgNum;
-             node->dirtyBit = 0;
-             node->fifoBit = 0;
-             if(node->next == NULL){
-               head->fifoBit = 1;
-             }else{
-               node->next->fifoBit = 1;   
-             }
-             node->fixCount = 1;
-             return RC_OK;
-        }
-        node->next->fifoBit = 1;
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pageListT *node;
+    int steps;
+    // The hand is at the oldest frame, it moves on past pinned frames.
+    for(steps = 0; steps < bm->numPages; steps++){
+      node = &pool->frames[pool->fifoHand];
+      pool->fifoHand = (pool->fifoHand + 1) % bm->numPages;
+      if(node->fixCount == 0){
+         replaceFrame(bm, node, pageT->pgNum);
+         node->fixCount = 1;
+         return RC_OK;
       }
-      node = node->next;
     }   
     return RC_NO_UNPINNED_PAGES_IN_BUFFER_POOL;
 }
@@ -80,7 +121,9 @@ extern RC FIF0(BM_BufferPool *const bm, pageListT *pageT){
  * Function Name: LRU 
  * 
  * Description: Page replacement strategy to replace page frames
- *               using least recently used algorithm.
+ *               using least recently used algorithm. The victim frame
+ *               takes over the page of pageT, the caller reads it in. 
+ *               O(log n).
  * 
  * Parameter: BM_BufferPool, pageListT
  * 
@@ -90,47 +133,198 @@ extern RC FIF0(BM_BufferPool *const bm, pageListT *pageT){
  ****************************************************************/
  extern RC LRU(BM_BufferPool *const bm,  pageListT *pageT)
 { 
-    pageListT *node = (pageListT *)bm->mgmtData;
-    int min = hit+1;
-   
-    while(node != NULL)
-    {
-        if(node->hitrate < min && node->fixCount == 0){
-            min = node->hitrate;
-        }
-        node = node->next;
-    }
-    node = (pageListT *)bm->mgmtData;
-    while(node != NULL){
-        if(node->hitrate == min){
-                if(node->dirtyBit==1){
-                    SM_FileHandle fHandle;
-                    openPageFile(bm->pageFile, &fHandle);
-                       writeBlock(node->pgNum, &fHandle, node->data);
-                       closePageFile(&fHandle);
-                       writeCount++;
-                       hit++;
-                 }    
-            node->data = pageT->data;
-            node->pgNum = pageT->pgNum;
-            node->dirtyBit = pageT->dirtyBit;
-            node->fixCount = pageT->fixCount;
-            node->hitrate = pageT->hitrate;
-            return RC_OK;
-        }
-        node= node->next;
-   
+    // Unpinned frames wait in the eviction heap keyed by their last use.
+    return evictHeapMin(bm, pageT);
+}
+
+/****************************************************************
+ * Function Name: CLOCK 
+ * 
+ * Description: Page replacement strategy giving frames a second 
+ *               chance. The hand goes round the frame array, clears
+ *               the reference bit of frames used since it last came
+ *               by and takes the first unpinned frame whose bit is 
+ *               already clear. Two rounds at most, amortized O(1).
+ * 
+ * Parameter: BM_BufferPool, pageListT
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+extern RC CLOCK(BM_BufferPool *const bm, pageListT *pageT){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pageListT *node;
+    int steps;
+    
+    for(steps = 0; steps < 2 * bm->numPages; steps++){
+      node = &pool->frames[pool->clockHand];
+      pool->clockHand = (pool->clockHand + 1) % bm->numPages;
+      if(node->fixCount != 0)
+        continue;
+      if(node->refBit == 1){
+        node->refBit = 0;
+        continue;
+      }
+      replaceFrame(bm, node, pageT->pgNum);
+      node->fixCount = pageT->fixCount;
+      node->hitrate = pageT->hitrate;
+      node->refBit = 1;
+      return RC_OK;
     }
     return RC_NO_UNPINNED_PAGES_IN_BUFFER_POOL;
 }
+
+/****************************************************************
+ * Function Name: evictHeapMin 
+ * 
+ * Description: Gives the unpinned frame with the smallest key, the 
+ *              root of the eviction heap, to the page of pageT and
+ *              starts the count and history of the new page.
+ * 
+ * Parameter: BM_BufferPool, pageListT
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+static RC evictHeapMin(BM_BufferPool *const bm, pageListT *pageT){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pageListT *node;
+    
+    if(pool->heapSize == 0)
+      return RC_NO_UNPINNED_PAGES_IN_BUFFER_POOL;
+    node = pool->heap[0];
+    heapRemove(pool, node);
+    replaceFrame(bm, node, pageT->pgNum);
+    node->refCount = 0;
+    memset(pool->history + (node - pool->frames) * pool->k, 0, pool->k * sizeof(long long));
+    node->fixCount = pageT->fixCount;
+    node->hitrate = pageT->hitrate;
+    referenceFrame(pool, node);
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: LFU 
+ * 
+ * Description: Page replacement strategy evicting the least 
+ *               frequently used page. A frame's key is its count plus
+ *               the key of the last victim when it was unpinned, so 
+ *               pages that were hot long ago age out. O(log n).
+ * 
+ * Parameter: BM_BufferPool, pageListT
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+extern RC LFU(BM_BufferPool *const bm, pageListT *pageT){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    
+    // An empty frame has no count to age the others by.
+    if(pool->heapSize > 0 && pool->heap[0]->pgNum != NO_PAGE)
+      pool->age = pool->heap[0]->heapKey;
+    return evictHeapMin(bm, pageT);
+}
+
+/****************************************************************
+ * Function Name: LRU_K 
+ * 
+ * Description: Page replacement strategy evicting the page whose 
+ *               K-th latest reference lies furthest back. Pages with
+ *               fewer than K references, like those of a scan, go 
+ *               first, least recently used among them. O(log n).
+ * 
+ * Parameter: BM_BufferPool, pageListT
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+extern RC LRU_K(BM_BufferPool *const bm, pageListT *pageT){
+  
+    return evictHeapMin(bm, pageT);
+}
+
+/****************************************************************
+ * Function Name: ARC 
+ * 
+ * Description: Adaptive replacement cache. Pages used once stay in 
+ *               ARC_T1, pages used again move to ARC_T2, and evicted
+ *               pages are remembered as ghosts in ARC_B1 and ARC_B2. 
+ *               A miss on a ghost shifts the target size of ARC_T1 
+ *               towards the list that lost it, so a scan only ever 
+ *               displaces pages of ARC_T1. The victim is the least 
+ *               recently used unpinned frame of the list the target 
+ *               picks, or of the other list when that one is pinned.
+ * 
+ * Parameter: BM_BufferPool, pageListT
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+extern RC ARC(BM_BufferPool *const bm, pageListT *pageT){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    int *size = pool->arcSize;
+    int c = bm->numPages, target = pool->arcTarget;
+    int ghost = tableFind(pool, pageT->pgNum), ghostList = -1;
+    int from, victim, oldList, remember = 1;
+    pageListT *node;
+    PageNumber oldPage;
+    
+    if(ghost >= c && ghost < 2 * c){
+      ghostList = pool->arcList[ghost];
+      if(ghostList == ARC_B1)
+        target += (size[ARC_B2] > size[ARC_B1]) ? size[ARC_B2] / size[ARC_B1] : 1;
+      else
+        target -= (size[ARC_B1] > size[ARC_B2]) ? size[ARC_B1] / size[ARC_B2] : 1;
+      target = (target < 0) ? 0 : (target > c) ? c : target;
+    }else
+      ghost = -1;
+    
+    // Pick the victim before changing anything, its list may be all pinned.
+    if(ghost < 0 && size[ARC_T1] + size[ARC_B1] >= c && size[ARC_B1] == 0){
+      from = ARC_T1;   // ARC_T1 holds every frame, its victim is not remembered
+      remember = 0;
+    }else if(size[ARC_T1] > 0 && (size[ARC_T1] > target || (ghostList == ARC_B2 && size[ARC_T1] == target)))
+      from = ARC_T1;
+    else
+      from = ARC_T2;
+    victim = arcVictim(pool, from);
+    if(victim < 0)
+      victim = arcVictim(pool, (from == ARC_T1) ? ARC_T2 : ARC_T1);
+    if(victim < 0)
+      return RC_NO_UNPINNED_PAGES_IN_BUFFER_POOL;
+    
+    pool->arcTarget = target;
+    if(ghost >= 0)
+      ghostDrop(pool, ghost);
+    else if(size[ARC_T1] + size[ARC_B1] >= c && size[ARC_B1] > 0)
+      ghostDrop(pool, pool->arcTail[ARC_B1]);
+    else if(size[ARC_T1] + size[ARC_T2] + size[ARC_B1] + size[ARC_B2] >= 2 * c && size[ARC_B2] > 0)
+      ghostDrop(pool, pool->arcTail[ARC_B2]);
+    
+    node = &pool->frames[victim];
+    oldPage = node->pgNum;
+    oldList = pool->arcList[victim];
+    replaceFrame(bm, node, pageT->pgNum);
+    arcUnlink(pool, victim);
+    if(remember && oldPage != NO_PAGE)
+      ghostAdd(pool, oldPage, (oldList == ARC_T1) ? ARC_B1 : ARC_B2);
+    // A ghost was used before, the page goes straight to ARC_T2.
+    if(ghost >= 0)
+      arcLink(pool, victim, ARC_T2);
+    node->fixCount = pageT->fixCount;
+    node->hitrate = pageT->hitrate;
+    referenceFrame(pool, node);
+    return RC_OK;
+}
  
 /***Pool Handeling implementation****/
 
 /****************************************************************
  * Function Name: initBufferPool 
  * 
- * Description: Creates new buffer pool with numPages 
- *                        
+ * Description: Creates new buffer pool with numPages frames, kept
+ *              in one array, and the table finding the frame of a 
+ *              page number. The page memory of all frames is reserved
+ *              here as one page aligned arena, pins never allocate.
  * 
  * Parameter: BM_BufferPool, pageFileName, numPages, ReplacementStrategy, stratData
  * 
@@ -144,32 +338,118 @@ RC initBufferPool(BM_BufferPool *const bm, char *pageFileName,
   						
   pthread_mutex_lock(&mutex_init); 				
 						
-  head = (pageListT *)malloc(sizeof(pageListT));                       
+  poolInfoT *pool;
+  int i, tableSize = 1;
+  // Each pool has its own statistics, on cache lines no other pool shares.
+  if(posix_memalign((void **)&pool, CACHE_LINE_SIZE, sizeof(poolInfoT)) != 0){
+    pthread_mutex_unlock(&mutex_init);
+    return RC_NOT_OK;
+  }
   bm->pageFile = pageFileName;
   bm->numPages = numPages;
   bm->strategy = strategy;
-  writeCount = 0;
-  readCount = 0;
-  hit=0;
- 
-   // Initilize head of the page frame. 
-    head->data = NULL;
-    head->fixCount = 0;
-    head->dirtyBit = 0;
-    head->fifoBit = 1;
-    head->pgNum = NO_PAGE;
-    head->next = NULL;
-    head->hitrate=0;
-   
-  int bufferSize = numPages;
+  atomic_init(&pool->readCount, 0);
+  atomic_init(&pool->writeCount, 0);
+  atomic_init(&pool->evictWrites, 0);
+  pool->hit = 0;
+  
+  // The page file stays open until shutdown, misses and write backs 
+  // are one positional read or write on it.
+  if(openPageFile(pageFileName, &pool->fHandle) != RC_OK){
+    free(pool);
+    pthread_mutex_unlock(&mutex_init);
+    return RC_FILE_NOT_FOUND;
+  }
  
-  //pageListT *node = NULL;
-  while(bufferSize > 1){
-    initPageFrame(head);
-    bufferSize--;
+  size_t arenaSize = (size_t)numPages * PAGE_SIZE;
+  size_t align = (arenaSize >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : PAGE_SIZE;
+  if(posix_memalign((void **)&pool->arena, align, arenaSize) != 0){
+    closePageFile(&pool->fHandle);
+    free(pool);
+    pthread_mutex_unlock(&mutex_init);
+    return RC_NOT_OK;
+  }
+#ifdef MADV_HUGEPAGE
+  if(align == HUGE_PAGE_SIZE)
+    madvise(pool->arena, arenaSize, MADV_HUGEPAGE);
+#endif
+  
+  // The frames are linked in array order so they can still be walked.
+  pool->frames = (pageListT *)malloc(numPages * sizeof(pageListT));
+  for(i = 0; i < numPages; i++){
+    initPageFrame(&pool->frames[i]);
+    pool->frames[i].data = pool->arena + (size_t)i * PAGE_SIZE;
+    pool->frames[i].next = (i + 1 < numPages) ? &pool->frames[i + 1] : NULL;
+    pthread_rwlock_init(&pool->frames[i].latch, NULL);
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->ioDone, NULL);
+  pthread_cond_init(&pool->cleanerWake, NULL);
+  pool->cleanerOn = 0;
+  pool->cleanerStop = 0;
+  pool->cleanTarget = 0;
+  pthread_cond_init(&pool->prefetchWake, NULL);
+  pool->prefetcherOn = 0;
+  pool->prefetchStop = 0;
+  pool->held = 0;
+  pool->prefetchQueue = (PageNumber *)malloc(numPages * sizeof(PageNumber));
+  pool->prefetchHead = 0;
+  pool->prefetchCount = 0;
+  pool->readAhead = 0;
+  pool->seqLast = NO_PAGE;
+  pool->seqRun = 0;
+  pool->seqAhead = NO_PAGE;
+  pool->fifoHand = 0;
+  pool->numUsed = 0;
+  pool->clockHand = 0;
+  
+  pool->numFrames = numPages;
+  // RS_LRU_K takes K from stratData, two when it is not given.
+  pool->k = 1;
+  if(strategy == RS_LRU_K)
+    pool->k = (stratData != NULL && *(int *)stratData > 0) ? *(int *)stratData : 2;
+  pool->heap = NULL;
+  pool->history = NULL;
+  if(strategy == RS_LRU || strategy == RS_LFU || strategy == RS_LRU_K){
+    pool->heap = (pageListT **)malloc(numPages * sizeof(pageListT *));
+    pool->history = (long long *)calloc((size_t)numPages * pool->k, sizeof(long long));
+  }
+  pool->heapSize = 0;
+  pool->tick = 0;
+  pool->age = 0;
+  pool->lastPage = NO_PAGE;
+  
+  // RS_ARC links frames and ghosts, ghost entries are numbered after the frames.
+  pool->ghosts = NULL;
+  pool->arcList = pool->arcPrev = pool->arcNext = NULL;
+  if(strategy == RS_ARC){
+    pool->ghosts = (PageNumber *)malloc(numPages * sizeof(PageNumber));
+    pool->arcList = (int *)malloc(2 * numPages * sizeof(int));
+    pool->arcPrev = (int *)malloc(2 * numPages * sizeof(int));
+    pool->arcNext = (int *)malloc(2 * numPages * sizeof(int));
+    for(i = 0; i < ARC_LISTS; i++){
+      pool->arcHead[i] = pool->arcTail[i] = -1;
+      pool->arcSize[i] = 0;
+    }
+    for(i = 0; i < 2 * numPages; i++)
+      pool->arcList[i] = -1;
+    for(i = 0; i < numPages; i++){
+      pool->ghosts[i] = NO_PAGE;
+      arcLink(pool, numPages + i, ARC_FREE);
+    }
   }
-  //bm->mgmtData = node;
-  bm->mgmtData = head;
+  pool->arcTarget = 0;
+  
+  // At most half full, so probe sequences stay short. Pages being written
+  // back and ghosts have entries too.
+  while(tableSize < 2 * ((strategy == RS_ARC) ? 3 * numPages : 2 * numPages))
+    tableSize *= 2;
+  pool->table = (int *)malloc(tableSize * sizeof(int));
+  for(i = 0; i < tableSize; i++)
+    pool->table[i] = -1;
+  pool->tableMask = tableSize - 1;
+  
+  bm->mgmtData = pool;
   pthread_mutex_unlock(&mutex_init); 
   return RC_OK;
 }
@@ -177,7 +457,7 @@ RC initBufferPool(BM_BufferPool *const bm, char *pageFileName,
 /****************************************************************
  * Function Name: initPageFrame 
  * 
- * Description: Creates page frames to be accomodated in the buffer pool.
+ * Description: Resets a page frame of the buffer pool to hold no page.
  * 
  * Parameter: pageListT
  * 
@@ -185,21 +465,24 @@ RC initBufferPool(BM_BufferPool *const bm, char *pageFileName,
  * 
  * Author: Dhruvit Modi  (dmodi2@hawk.iit.edu)
  ****************************************************************/
-RC initPageFrame(pageListT* head_ref){
+RC initPageFrame(pageListT* frame){
    
     //Represents a page in a frame.
-    pageListT* current = head_ref;
-    while(current->next != NULL){
-        current = current->next;
-    }
-    current->next = (pageListT *)malloc(sizeof(pageListT));
-    current->next->data = NULL;
-    current->next->fixCount = 0;
-    current->next->dirtyBit = 0;
-    current->next->fifoBit = 0;
-    current->next->pgNum = NO_PAGE;
-    current->next->next = NULL;
-    current->next->hitrate=0;
+    frame->data = NULL;
+    frame->fixCount = 0;
+    frame->dirtyBit = 0;
+    frame->pgNum = NO_PAGE;
+    frame->hitrate=0;
+    frame->refBit = 0;
+    frame->refCount = 0;
+    frame->heapKey = 0;
+    frame->heapPos = -1;
+    frame->io = 0;
+    frame->writePage = NO_PAGE;
+    frame->prefetched = 0;
+    frame->refs = NULL;
+    frame->numRefs = 0;
+    frame->maxRefs = 0;
     return RC_OK;
 }
 
@@ -222,16 +505,43 @@ RC shutdownBufferPool(BM_BufferPool *const bm){
       return RC_BUFFER_POOL_NOT_INIT;
   }
  
-  pageListT *node = (pageListT *)bm->mgmtData;
+  poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+  pageListT *node = pool->frames;
  
+  // The cleaner and the prefetcher hold the frames they work on, stop them first.
+  stopPageCleaner(bm);
+  stopPrefetcher(pool);
   /*Check each node to see if its fix count is 0*/ 
   while(node != NULL){
       if(node->fixCount != 0)
         return RC_BUFFER_POOL_CONTAINS_PINNED_PAGES;
       node = node->next; 
   }
-  forceFlushPool(bm);
-  free(node);
+  // Pages that could not be written keep the pool open.
+  RC error = forceFlushPool(bm);
+  if(error != RC_OK)
+    return error;
+  for(node = pool->frames; node != NULL; node = node->next){
+      unswizzleFrame(node);
+      free(node->refs);
+      pthread_rwlock_destroy(&node->latch);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->ioDone);
+  pthread_cond_destroy(&pool->cleanerWake);
+  pthread_cond_destroy(&pool->prefetchWake);
+  closePageFile(&pool->fHandle);
+  free(pool->arena);
+  free(pool->frames);
+  free(pool->table);
+  free(pool->heap);
+  free(pool->history);
+  free(pool->ghosts);
+  free(pool->arcList);
+  free(pool->arcPrev);
+  free(pool->arcNext);
+  free(pool->prefetchQueue);
+  free(pool);
   bm->mgmtData = NULL;
   return RC_OK;
 }
@@ -255,21 +565,45 @@ RC forceFlushPool(BM_BufferPool *const bm){
       return RC_BUFFER_POOL_NOT_INIT;
   }
  
-  pageListT *node = (pageListT *)bm->mgmtData;
-  SM_FileHandle fHandle;
+  poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+  pageListT *node = pool->frames;
+  RC error, firstError = RC_OK;
  
+  pthread_mutex_lock(&pool->lock);
   /*Check each node to see if its dirty bit is set and fix count is 0*/ 
   while(node != NULL){
       if(node->dirtyBit == 1 && node->fixCount == 0){
-        openPageFile(bm->pageFile, &fHandle);
-        writeBlock(node->pgNum, &fHandle, node->data);
-        closePageFile(&fHandle);
+        // Held while it is written so it is not replaced, the write runs
+        // without the pool lock and under a shared latch.
+        node->fixCount++;
+        pool->held++;
+        if(node->heapPos >= 0)
+          heapRemove(pool, node);
         node->dirtyBit = 0;
-        writeCount++;
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_rdlock(&node->latch);
+        // Frames are not flushed in page order, the write grows the file.
+        error = pwriteBlock(node->pgNum, &pool->fHandle, node->data);
+        pthread_rwlock_unlock(&node->latch);
+        pthread_mutex_lock(&pool->lock);
+        // A page that failed stays dirty, the other pages are still flushed.
+        if(error == RC_OK)
+          atomic_fetch_add_explicit(&pool->writeCount, 1, memory_order_relaxed);
+        else{
+          node->dirtyBit = 1;
+          if(firstError == RC_OK)
+            firstError = error;
+        }
+        node->fixCount--;
+        if(pool->heap != NULL)
+          releaseFrame(bm, node);
+        pool->held--;
+        pthread_cond_broadcast(&pool->ioDone);
       }
       node = node->next;
   }
-  return RC_OK;
+  pthread_mutex_unlock(&pool->lock);
+  return firstError;
 }
 
 /*****Buffer Manager Access implementation****/
@@ -292,16 +626,15 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
   if(bm == NULL){
     return RC_BUFFER_POOL_NOT_INIT;
   }
-  pageListT *node = (pageListT *)bm->mgmtData;
-  while(node != NULL){
-      if(node->pgNum == page->pageNum){
-        node->data = page->data; 
-        node->dirtyBit = 1;
-        return RC_OK;
-      }
-      node = node->next;
-  }
+  poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+  pthread_mutex_lock(&pool->lock);
+  int frame = frameLookup(pool, page->pageNum);
+  if(frame >= 0)
+    pool->frames[frame].dirtyBit = 1;
+  pthread_mutex_unlock(&pool->lock);
+  if(frame < 0)
     return RC_PAGE_NOT_PINNED_IN_BUFFER_POOL;
+  return RC_OK;
 }
 
 
@@ -309,7 +642,8 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
  * Function Name: forcePage 
  * 
  * Description: Writes the current page content back to the 
- *              pagefile on disk.
+ *              pagefile on disk. The caller holds a pin on the page,
+ *              the write runs without the pool lock.
  * 
  * Parameter: BM_BufferPool, BM_PageHandle
  * 
@@ -325,29 +659,45 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page){
       return RC_BUFFER_POOL_NOT_INIT;
   }
  
-  pageListT *node = (pageListT *)bm->mgmtData;
-  SM_FileHandle fHandle;
- 
-  while(node->pgNum != page->pageNum){
-      node = node->next;
+  poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+  int dirty = 0;
+  pthread_mutex_lock(&pool->lock);
+  int frame = frameLookup(pool, page->pageNum);
+  if(frame >= 0){
+    dirty = pool->frames[frame].dirtyBit;
+    pool->frames[frame].dirtyBit = 0;
   }
-  if(node == NULL)
+  pthread_mutex_unlock(&pool->lock);
+ 
+  if(frame < 0)
     return RC_PAGE_NOT_PINNED_IN_BUFFER_POOL;
-  if(node->dirtyBit == 1){ 
-    openPageFile(bm->pageFile, &fHandle);
-    writeBlock(node->pgNum, &fHandle, node->data);
-    node->dirtyBit = 0; 
-    writeCount++;
-   
+  pageListT *node = &pool->frames[frame];
+  RC error = RC_OK;
+  if(dirty == 1){ 
+    error = pwriteBlock(node->pgNum, &pool->fHandle, node->data);
+    if(error == RC_OK)
+      atomic_fetch_add_explicit(&pool->writeCount, 1, memory_order_relaxed);
+    else{
+      // Not on disk, the page has to be written again.
+      pthread_mutex_lock(&pool->lock);
+      node->dirtyBit = 1;
+      pthread_mutex_unlock(&pool->lock);
+    }
   }
  
-  return RC_OK;
+  return error;
 }
 
 /****************************************************************
  * Function Name: pinPage 
  * 
- * Description: Pins the page with page number pageNum.
+ * Description: Pins the page with page number pageNum. A miss sets
+ *              up its frame under the pool lock and does the I/O 
+ *              without it. Pins of a page that is being read in, or 
+ *              written back, wait for that I/O, so concurrent misses 
+ *              on a page read it once. With read-ahead on, a run of
+ *              pins going one page further each has the next pages 
+ *              read ahead.
  * 
  * Parameter: BM_BufferPool, BM_PageHandle, PageNumber
  * 
@@ -359,104 +709,194 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page){
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
         const PageNumber pageNum){
 			
-    pthread_mutex_lock(&mutex_pinPage);          
     if(bm == NULL){
       return RC_BUFFER_POOL_NOT_INIT;
     }       
          
              
-      pageListT *node = (pageListT *)bm->mgmtData;
-     
-      //SM_FileHandle fHandle;
-      RC readError;
-      // No pages in memory.
-      if(node->pgNum == NO_PAGE){  
-        SM_FileHandle fHandle;   
-        openPageFile(bm->pageFile, &fHandle);
-        node->data = (SM_PageHandle)malloc(PAGE_SIZE);
-        readError = readBlock(pageNum, &fHandle, node->data);
-        if(readError == RC_READ_ERROR){
-          return readError;
-        }
-        readCount++;
-        hit++;
-        node->hitrate = hit;
-        node->pgNum = pageNum;
-        node->fixCount++;
-        page->pageNum = pageNum;
-        page->data = node->data;
-        closePageFile(&fHandle);
-        pthread_mutex_unlock(&mutex_pinPage);        
-        return RC_OK;
-    }else{
-        while(node != NULL && node->pgNum != NO_PAGE){
+      poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+      pageListT *node;
+      RC error, readError;
+      int frame;
+      
+      pthread_mutex_lock(&pool->lock);
+      readAhead(bm, pageNum);
+      for(;;){
+          while(pageBusy(pool, pageNum))
+              pthread_cond_wait(&pool->ioDone, &pool->lock);
+          frame = frameLookup(pool, pageNum);
+          
           // Page already exist in memory   
-          if(node->pgNum == pageNum){
+          if(frame >= 0){
+              node = &pool->frames[frame];
               node->fixCount++;
-              hit++;
-              node->hitrate = hit;
+              node->refBit = 1;
+              referenceFrame(pool, node);
+              pool->hit++;
+              node->hitrate = pool->hit;
               page->pageNum = pageNum;
               page->data = node->data;
-              pthread_mutex_unlock(&mutex_pinPage);        
+              pthread_mutex_unlock(&pool->lock);        
               return RC_OK;
           }
-          node = node->next;
+          error = claimFrame(bm, pageNum, &node);
+          // Background threads hold frames only until their I/O is done.
+          if(error == RC_OK || pool->held == 0)
+              break;
+          pthread_cond_wait(&pool->ioDone, &pool->lock);
+      }
+      if(error != RC_OK){
+          pthread_mutex_unlock(&pool->lock);
+          return error;
+      }
+        
+        // The frame is pinned and marked, write back and read without the lock.
+        pthread_mutex_unlock(&pool->lock);
+        readError = loadFrame(bm, node, pageNum);
+        pthread_mutex_unlock(&pool->lock);
+        if(readError != RC_OK){
+          return readError;
         }
-        // Page not in memory and buffer has spce left.
-        if(node != NULL){
-            SM_FileHandle fHandle;
-            openPageFile (bm->pageFile, &fHandle);
-            node->data = (SM_PageHandle)malloc(PAGE_SIZE);
-            readError = readBlock(pageNum, &fHandle, node->data);
-            if(readError == RC_READ_ERROR){
-              return readError;
-            }
-            closePageFile(&fHandle);
-            readCount++;
-            hit++;
-            node->hitrate = hit;
+        page->pageNum = pageNum;
+        page->data = node->data; 
+        return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: claimFrame 
+ * 
+ * Description: Sets up a frame for page pageNum, which is not in the
+ *              pool. Takes the next free frame, or the victim of the
+ *              replacement strategy once all are used. The frame is 
+ *              pinned and marked for I/O, called with the pool lock.
+ * 
+ * Parameter: BM_BufferPool, PageNumber, pageListT
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+static RC claimFrame(BM_BufferPool *const bm, PageNumber pageNum, pageListT **frame){
+  
+        poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+        pageListT *node;
+        // Page not in memory and buffer has spce left, frames fill in order.
+        if(pool->numUsed < bm->numPages){
+            node = &pool->frames[pool->numUsed];
+            pool->hit++;
+            node->hitrate = pool->hit;
             node->pgNum = pageNum;
+            frameTableInsert(pool, pageNum, pool->numUsed++);
             node->fixCount++;
-            page->pageNum = pageNum;
-            page->data = node->data;
-            pthread_mutex_unlock(&mutex_pinPage);        
-            return RC_OK;
+            node->refBit = 1;
+            referenceFrame(pool, node);
         }
         // Page not in memory and buffer full. Replace page
         else{
-            SM_FileHandle fHandle;
-            pageListT *newNode = (pageListT *)malloc(sizeof(pageListT));
-            openPageFile(bm->pageFile, &fHandle);
-            newNode->data = (SM_PageHandle)malloc(PAGE_SIZE);
-            readError = readBlock(pageNum, &fHandle, newNode->data);
-            newNode->pgNum = pageNum;
-            if(readError == RC_READ_ERROR){
-              return RC_READ_ERROR;
+            pageListT newNode;
+            RC error;
+            newNode.pgNum = pageNum;
+            newNode.fixCount = 1;
+            newNode.dirtyBit = 0;
+            newNode.hitrate = pool->hit;
+            pool->hit++;
+            // Implement replacement startegy, the victim frame takes the page.
+            if(bm->strategy == RS_LRU)
+              error = LRU(bm, &newNode);
+            else if(bm->strategy == RS_CLOCK)
+              error = CLOCK(bm, &newNode);
+            else if(bm->strategy == RS_LFU)
+              error = LFU(bm, &newNode);
+            else if(bm->strategy == RS_LRU_K)
+              error = LRU_K(bm, &newNode);
+            else if(bm->strategy == RS_ARC)
+              error = ARC(bm, &newNode);
+            else
+              error = FIF0(bm, &newNode);
+            if(error != RC_OK){
+              return error;
             }
-            closePageFile(&fHandle);
-            newNode->fixCount = 1;
-            newNode->dirtyBit = 0;
-            newNode->hitrate = hit;
-            readCount++;
-            hit++;
-            // Implement replacement startegy 
-            if(bm->strategy == RS_FIFO)
-              FIF0(bm, newNode);
-            else if(bm->strategy == RS_LRU)
-              LRU(bm, newNode);
-            else; 
-            page->pageNum = pageNum;
-            page->data = newNode->data; 
-            pthread_mutex_unlock(&mutex_pinPage);        
-            return RC_OK;
+            node = &pool->frames[frameLookup(pool, pageNum)];
         }
-    }   
+        node->io = 1;
+        *frame = node;
+        return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: loadFrame 
+ * 
+ * Description: Does the I/O of a frame set up by claimFrame: writes
+ *              back the page it held if that was dirty and reads page
+ *              pageNum in. Called without the pool lock, returns with
+ *              it. A failed read leaves the frame empty, unpinned and 
+ *              first in line to be given out again, a failed write 
+ *              leaves it with the old page, dirty.
+ * 
+ * Parameter: BM_BufferPool, pageListT, PageNumber
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+static RC loadFrame(BM_BufferPool *const bm, pageListT *node, PageNumber pageNum){
+  
+        poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+        int frame = node - pool->frames, ghost;
+        RC writeError = RC_OK, readError;
+        if(node->writePage != NO_PAGE){
+          writeError = pwriteBlock(node->writePage, &pool->fHandle, node->data);
+          if(writeError == RC_OK){
+            atomic_fetch_add_explicit(&pool->writeCount, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&pool->evictWrites, 1, memory_order_relaxed);
+          }
+          // The cleaner fell behind, have it run now.
+          if(pool->cleanerOn)
+            pthread_cond_signal(&pool->cleanerWake);
+        }
+        readError = (writeError == RC_OK) ? readFrame(bm, node, pageNum) : writeError;
+        
+        pthread_mutex_lock(&pool->lock);
+        if(writeError != RC_OK){
+          // The victim was not written, it keeps its page and stays dirty.
+          frameTableRemove(pool, 2 * pool->numFrames + frame);
+          frameTableRemove(pool, frame);
+          if(pool->ghosts != NULL && (ghost = tableFind(pool, node->writePage)) >= 0)
+            ghostDrop(pool, ghost);
+          node->pgNum = node->writePage;
+          node->writePage = NO_PAGE;
+          frameTableInsert(pool, node->pgNum, frame);
+          node->dirtyBit = 1;
+          node->fixCount--;
+          if(pool->heap != NULL)
+            releaseFrame(bm, node);
+        }
+        else{
+          if(node->writePage != NO_PAGE){
+            frameTableRemove(pool, 2 * pool->numFrames + frame);
+            node->writePage = NO_PAGE;
+          }
+          if(readError != RC_OK){
+            frameTableRemove(pool, frame);
+            node->pgNum = NO_PAGE;
+            node->fixCount--;
+            node->refBit = 0;
+            if(pool->lastPage == pageNum)
+              pool->lastPage = NO_PAGE;
+            if(pool->heap != NULL)
+              releaseFrame(bm, node);
+            if(pool->ghosts != NULL)
+              arcLinkLast(pool, frame, ARC_T1);
+          }
+        }
+        node->io = 0;
+        pthread_cond_broadcast(&pool->ioDone);
+        return readError;
 }
 
 /****************************************************************
  * Function Name: unpinPage 
  * 
- * Description: Unpins the page with page number pageNum.
+ * Description: Unpins the page with page number pageNum. Pin counts
+ *              are atomic, the pool lock is only taken when the last
+ *              pin of a frame goes and the strategy keeps an eviction
+ *              heap.
  * 
  * Parameter: BM_BufferPool, BM_PageHandle
  * 
@@ -470,21 +910,1091 @@ RC unpinPage(BM_BufferPool * const bm, BM_PageHandle * const page) {
     if(bm == NULL){
       return RC_BUFFER_POOL_NOT_INIT;
     }       
-      pthread_mutex_lock(&mutex_unpinPage);    
              
-      pageListT *node = (pageListT *)bm->mgmtData;
-        while(node != NULL && node->pgNum != NO_PAGE){   
-          if(node->pgNum == page->pageNum){
-              node->fixCount--;
-              break;
-            }
-            node = node->next;
-        }    
-        //printf("Fix Count: %d\n", node->fixCount);  
-        pthread_mutex_unlock(&mutex_unpinPage);           
+      poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+      pageListT *node = pinnedFrame(pool, page);
+      if(node != NULL && atomic_fetch_sub(&node->fixCount, 1) == 1 && pool->heap != NULL){
+          // The eviction heap is shared with pinPage.
+          pthread_mutex_lock(&pool->lock);
+          releaseFrame(bm, node);
+          pthread_mutex_unlock(&pool->lock);
+      }
  return RC_OK;
 }
 
+/****************************************************************
+ * Function Name: pinnedFrame 
+ * 
+ * Description: Finds the frame of a page the caller has pinned. The
+ *              handle points into the arena, so the frame follows from
+ *              the address without the pool lock. A handle that does
+ *              not is looked up in the table.
+ * 
+ * Parameter: poolInfoT, BM_PageHandle
+ * 
+ * Return: pageListT, NULL when the page is not in the pool
+ ****************************************************************/
+static pageListT *pinnedFrame(poolInfoT *pool, BM_PageHandle *const page){
+  
+    size_t offset = (size_t)(page->data - pool->arena);
+    int frame;
+    if(page->data >= pool->arena && offset < (size_t)pool->numFrames * PAGE_SIZE
+       && offset % PAGE_SIZE == 0 && pool->frames[offset / PAGE_SIZE].pgNum == page->pageNum)
+      return &pool->frames[offset / PAGE_SIZE];
+    pthread_mutex_lock(&pool->lock);
+    frame = frameLookup(pool, page->pageNum);
+    pthread_mutex_unlock(&pool->lock);
+    return (frame < 0) ? NULL : &pool->frames[frame];
+}
+
+/****************************************************************
+ * Function Name: latchPage 
+ * 
+ * Description: Latches the content of a pinned page, shared for 
+ *              readers or exclusive for a writer. Pins only keep the
+ *              page in its frame, threads changing a page they share
+ *              latch it. Flushing takes the latch shared.
+ * 
+ * Parameter: BM_BufferPool, BM_PageHandle, bool
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC latchPage(BM_BufferPool *const bm, BM_PageHandle *const page,
+        bool exclusive){
+  
+    if(bm == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    pageListT *node = pinnedFrame((poolInfoT *)bm->mgmtData, page);
+    if(node == NULL)
+      return RC_PAGE_NOT_PINNED_IN_BUFFER_POOL;
+    if(exclusive)
+      pthread_rwlock_wrlock(&node->latch);
+    else
+      pthread_rwlock_rdlock(&node->latch);
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: unlatchPage 
+ * 
+ * Description: Releases the latch taken by latchPage.
+ * 
+ * Parameter: BM_BufferPool, BM_PageHandle
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC unlatchPage(BM_BufferPool *const bm, BM_PageHandle *const page){
+  
+    if(bm == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    pageListT *node = pinnedFrame((poolInfoT *)bm->mgmtData, page);
+    if(node == NULL)
+      return RC_PAGE_NOT_PINNED_IN_BUFFER_POOL;
+    pthread_rwlock_unlock(&node->latch);
+    return RC_OK;
+}
+
+
+/****************************************************************
+ * Function Name: readFrame 
+ * 
+ * Description: Reads page pageNum from the page file into the frame,
+ *              one positional read on the pool's file handle. A page 
+ *              past the end of the file reads as zeros, it is created
+ *              when it is written back.
+ * 
+ * Parameter: BM_BufferPool, pageListT, PageNumber
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+static RC readFrame(BM_BufferPool *const bm, pageListT *node, PageNumber pageNum){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    RC readError = preadBlock(pageNum, &pool->fHandle, node->data);
+    if(readError == RC_READ_NON_EXISTING_PAGE){
+      memset(node->data, 0, PAGE_SIZE);
+      return RC_OK;
+    }
+    if(readError == RC_OK)
+      atomic_fetch_add_explicit(&pool->readCount, 1, memory_order_relaxed);
+    return readError;
+}
+
+
+/*****Frame table implementation****/
+
+/****************************************************************
+ * Function Name: hashPage 
+ * 
+ * Description: Spreads page numbers over the frame table, neighbouring
+ *              pages land in different slots.
+ * 
+ * Parameter: PageNumber
+ * 
+ * Return: unsigned int
+ ****************************************************************/
+static unsigned int hashPage(PageNumber pageNum){
+  
+    unsigned int h = (unsigned int)pageNum * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+/****************************************************************
+ * Function Name: tablePage 
+ * 
+ * Description: Returns the page of a table entry: a frame index, 
+ *              from numFrames on an RS_ARC ghost and from twice that
+ *              a page a frame still has to write back.
+ * 
+ * Parameter: poolInfoT, int
+ * 
+ * Return: PageNumber
+ ****************************************************************/
+static PageNumber tablePage(poolInfoT *pool, int entry){
+  
+    if(entry < pool->numFrames)
+      return pool->frames[entry].pgNum;
+    if(entry < 2 * pool->numFrames)
+      return pool->ghosts[entry - pool->numFrames];
+    return pool->frames[entry - 2 * pool->numFrames].writePage;
+}
+
+/****************************************************************
+ * Function Name: tableFind 
+ * 
+ * Description: Finds the table entry of page pageNum. Probes from the
+ *              page's home slot until an empty slot, the table is 
+ *              never more than half full.
+ * 
+ * Parameter: poolInfoT, PageNumber
+ * 
+ * Return: entry, -1 when the page has none (int)
+ ****************************************************************/
+static int tableFind(poolInfoT *pool, PageNumber pageNum){
+  
+    unsigned int slot = hashPage(pageNum) & pool->tableMask;
+    while(pool->table[slot] != -1){
+      if(tablePage(pool, pool->table[slot]) == pageNum)
+        return pool->table[slot];
+      slot = (slot + 1) & pool->tableMask;
+    }
+    return -1;
+}
+
+/****************************************************************
+ * Function Name: pageBusy 
+ * 
+ * Description: Tells whether page pageNum is being read into a frame
+ *              or still has to be written back. An RS_ARC ghost of the
+ *              page may sit in the table next to the write back entry.
+ * 
+ * Parameter: poolInfoT, PageNumber
+ * 
+ * Return: int
+ ****************************************************************/
+static int pageBusy(poolInfoT *pool, PageNumber pageNum){
+  
+    unsigned int slot = hashPage(pageNum) & pool->tableMask;
+    int entry;
+    while((entry = pool->table[slot]) != -1){
+      if(tablePage(pool, entry) == pageNum
+         && (entry >= 2 * pool->numFrames || (entry < pool->numFrames && pool->frames[entry].io)))
+        return 1;
+      slot = (slot + 1) & pool->tableMask;
+    }
+    return 0;
+}
+
+/****************************************************************
+ * Function Name: frameLookup 
+ * 
+ * Description: Finds the frame holding page pageNum.
+ * 
+ * Parameter: poolInfoT, PageNumber
+ * 
+ * Return: frame index, -1 when the page is not in the pool (int)
+ ****************************************************************/
+static int frameLookup(poolInfoT *pool, PageNumber pageNum){
+  
+    int entry = tableFind(pool, pageNum);
+    return (entry < pool->numFrames) ? entry : -1;
+}
+
+/****************************************************************
+ * Function Name: frameTableInsert 
+ * 
+ * Description: Records that frame, or ghost entry, holds page pageNum.
+ * 
+ * Parameter: poolInfoT, PageNumber, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void frameTableInsert(poolInfoT *pool, PageNumber pageNum, int frame){
+  
+    unsigned int slot = hashPage(pageNum) & pool->tableMask;
+    while(pool->table[slot] != -1)
+      slot = (slot + 1) & pool->tableMask;
+    pool->table[slot] = frame;
+}
+
+/****************************************************************
+ * Function Name: frameTableRemove 
+ * 
+ * Description: Removes a table entry. Must be called while the entry
+ *              still holds its page. Entries after the hole that would
+ *              no longer be reachable from their home slot are moved 
+ *              back into it, so no tombstones are needed.
+ * 
+ * Parameter: poolInfoT, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void frameTableRemove(poolInfoT *pool, int entry){
+  
+    unsigned int hole, slot, home;
+    PageNumber pageNum = tablePage(pool, entry);
+    if(pageNum == NO_PAGE)
+      return;
+    hole = hashPage(pageNum) & pool->tableMask;
+    while(pool->table[hole] != -1 && pool->table[hole] != entry)
+      hole = (hole + 1) & pool->tableMask;
+    if(pool->table[hole] == -1)
+      return;
+    
+    slot = hole;
+    while(1){
+      slot = (slot + 1) & pool->tableMask;
+      if(pool->table[slot] == -1)
+        break;
+      home = hashPage(tablePage(pool, pool->table[slot])) & pool->tableMask;
+      // Leave entries whose home lies cyclically in (hole, slot].
+      if(hole <= slot ? (home > hole && home <= slot) : (home > hole || home <= slot))
+        continue;
+      pool->table[hole] = pool->table[slot];
+      hole = slot;
+    }
+    pool->table[hole] = -1;
+}
+
+
+/*****Eviction heap implementation****/
+
+/****************************************************************
+ * Function Name: referenceFrame 
+ * 
+ * Description: Records a pin of the frame for RS_LRU, RS_LFU, RS_LRU_K
+ *              and RS_ARC. Takes the frame out of the eviction heap, or 
+ *              moves it to the front of its ARC list, to ARC_T2 once it
+ *              is used again. Back to back pins of one page, like a 
+ *              scan going through the records of a page, count as a 
+ *              single reference.
+ * 
+ * Parameter: poolInfoT, pageListT
+ * 
+ * Return: void
+ ****************************************************************/
+static void referenceFrame(poolInfoT *pool, pageListT *node){
+  
+    long long *history = NULL;
+    int i, frame = node - pool->frames;
+    // The first pin of a page read ahead is the reference reading it counted.
+    int repeated = (pool->lastPage == node->pgNum) || node->prefetched;
+    node->prefetched = 0;
+    pool->lastPage = node->pgNum;
+    pool->tick++;
+    if(pool->ghosts != NULL){
+      if(pool->arcList[frame] == -1)
+        arcLink(pool, frame, ARC_T1);
+      else if(!repeated)
+        arcLink(pool, frame, ARC_T2);
+    }
+    if(pool->heap == NULL)
+      return;
+    if(node->heapPos >= 0)
+      heapRemove(pool, node);
+    history = pool->history + frame * pool->k;
+    if(!repeated){
+      node->refCount++;
+      for(i = pool->k - 1; i > 0; i--)
+        history[i] = history[i - 1];
+    }
+    history[0] = pool->tick;
+}
+
+/****************************************************************
+ * Function Name: heapBefore 
+ * 
+ * Description: Tells whether frame a is evicted before frame b, the
+ *              one used longer ago goes first on equal keys, then the
+ *              one earlier in the frame array.
+ * 
+ * Parameter: pageListT, pageListT
+ * 
+ * Return: int
+ ****************************************************************/
+static int heapBefore(pageListT *a, pageListT *b){
+  
+    if(a->heapKey != b->heapKey)
+      return a->heapKey < b->heapKey;
+    if(a->hitrate != b->hitrate)
+      return a->hitrate < b->hitrate;
+    return a < b;
+}
+
+/****************************************************************
+ * Function Name: heapMove 
+ * 
+ * Description: Moves the frame at pos up or down the heap until the
+ *              heap order holds again.
+ * 
+ * Parameter: poolInfoT, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void heapMove(poolInfoT *pool, int pos){
+  
+    pageListT *node = pool->heap[pos];
+    int child;
+    while(pos > 0 && heapBefore(node, pool->heap[(pos - 1) / 2])){
+      pool->heap[pos] = pool->heap[(pos - 1) / 2];
+      pool->heap[pos]->heapPos = pos;
+      pos = (pos - 1) / 2;
+    }
+    while((child = 2 * pos + 1) < pool->heapSize){
+      if(child + 1 < pool->heapSize && heapBefore(pool->heap[child + 1], pool->heap[child]))
+        child++;
+      if(!heapBefore(pool->heap[child], node))
+        break;
+      pool->heap[pos] = pool->heap[child];
+      pool->heap[pos]->heapPos = pos;
+      pos = child;
+    }
+    pool->heap[pos] = node;
+    node->heapPos = pos;
+}
+
+/****************************************************************
+ * Function Name: heapRemove 
+ * 
+ * Description: Takes the frame out of the eviction heap, the last
+ *              frame of the heap fills its place.
+ * 
+ * Parameter: poolInfoT, pageListT
+ * 
+ * Return: void
+ ****************************************************************/
+static void heapRemove(poolInfoT *pool, pageListT *node){
+  
+    int pos = node->heapPos;
+    pageListT *last = pool->heap[--pool->heapSize];
+    node->heapPos = -1;
+    if(last == node)
+      return;
+    pool->heap[pos] = last;
+    last->heapPos = pos;
+    heapMove(pool, pos);
+}
+
+/****************************************************************
+ * Function Name: releaseFrame 
+ * 
+ * Description: Puts a frame whose last pin went into the eviction 
+ *              heap. RS_LRU keys it by its last use, RS_LFU by its 
+ *              count plus the current age,
+ *              RS_LRU_K by its K-th latest reference, or below every
+ *              such key by its latest one while it has fewer. A frame
+ *              left empty by a failed read goes before all of them.
+ * 
+ * Parameter: BM_BufferPool, pageListT
+ * 
+ * Return: void
+ ****************************************************************/
+static void releaseFrame(BM_BufferPool *const bm, pageListT *node){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    long long *history;
+    if(node->fixCount != 0 || node->heapPos >= 0)
+      return;
+    history = pool->history + (node - pool->frames) * pool->k;
+    if(node->pgNum == NO_PAGE)
+      node->heapKey = LLONG_MIN;
+    else if(bm->strategy == RS_LRU)
+      node->heapKey = node->hitrate;
+    else if(bm->strategy == RS_LFU)
+      node->heapKey = pool->age + node->refCount;
+    else if(history[pool->k - 1] == 0)
+      node->heapKey = history[0];
+    else
+      node->heapKey = LRU_K_FULL + history[pool->k - 1];
+    node->heapPos = pool->heapSize++;
+    pool->heap[node->heapPos] = node;
+    heapMove(pool, node->heapPos);
+}
+
+
+/*****ARC lists implementation****/
+
+/****************************************************************
+ * Function Name: arcLink 
+ * 
+ * Description: Makes a frame or ghost entry the most recently used 
+ *              one of list, taking it out of its current list first.
+ * 
+ * Parameter: poolInfoT, int, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void arcLink(poolInfoT *pool, int entry, int list){
+  
+    arcUnlink(pool, entry);
+    pool->arcList[entry] = list;
+    pool->arcPrev[entry] = -1;
+    pool->arcNext[entry] = pool->arcHead[list];
+    if(pool->arcHead[list] != -1)
+      pool->arcPrev[pool->arcHead[list]] = entry;
+    else
+      pool->arcTail[list] = entry;
+    pool->arcHead[list] = entry;
+    pool->arcSize[list]++;
+}
+
+/****************************************************************
+ * Function Name: arcLinkLast 
+ * 
+ * Description: Makes a frame the least recently used one of list, 
+ *              the next victim taken from it.
+ * 
+ * Parameter: poolInfoT, int, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void arcLinkLast(poolInfoT *pool, int entry, int list){
+  
+    arcUnlink(pool, entry);
+    pool->arcList[entry] = list;
+    pool->arcNext[entry] = -1;
+    pool->arcPrev[entry] = pool->arcTail[list];
+    if(pool->arcTail[list] != -1)
+      pool->arcNext[pool->arcTail[list]] = entry;
+    else
+      pool->arcHead[list] = entry;
+    pool->arcTail[list] = entry;
+    pool->arcSize[list]++;
+}
+
+/****************************************************************
+ * Function Name: arcUnlink 
+ * 
+ * Description: Takes a frame or ghost entry out of its list.
+ * 
+ * Parameter: poolInfoT, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void arcUnlink(poolInfoT *pool, int entry){
+  
+    int list = pool->arcList[entry];
+    if(list == -1)
+      return;
+    if(pool->arcPrev[entry] != -1)
+      pool->arcNext[pool->arcPrev[entry]] = pool->arcNext[entry];
+    else
+      pool->arcHead[list] = pool->arcNext[entry];
+    if(pool->arcNext[entry] != -1)
+      pool->arcPrev[pool->arcNext[entry]] = pool->arcPrev[entry];
+    else
+      pool->arcTail[list] = pool->arcPrev[entry];
+    pool->arcList[entry] = -1;
+    pool->arcSize[list]--;
+}
+
+/****************************************************************
+ * Function Name: arcVictim 
+ * 
+ * Description: Returns the least recently used unpinned frame of list.
+ * 
+ * Parameter: poolInfoT, int
+ * 
+ * Return: frame index, -1 when there is none (int)
+ ****************************************************************/
+static int arcVictim(poolInfoT *pool, int list){
+  
+    int entry;
+    for(entry = pool->arcTail[list]; entry != -1; entry = pool->arcPrev[entry]){
+      if(pool->frames[entry].fixCount == 0)
+        return entry;
+    }
+    return -1;
+}
+
+/****************************************************************
+ * Function Name: ghostAdd 
+ * 
+ * Description: Remembers an evicted page in ghost list list. When
+ *              pinned frames pushed the lists past their bounds and no
+ *              ghost entry is left, the oldest ghost is forgotten.
+ * 
+ * Parameter: poolInfoT, PageNumber, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void ghostAdd(poolInfoT *pool, PageNumber pageNum, int list){
+  
+    int entry;
+    if(pool->arcSize[ARC_FREE] == 0)
+      ghostDrop(pool, pool->arcTail[(pool->arcSize[ARC_B1] > 0) ? ARC_B1 : ARC_B2]);
+    entry = pool->arcHead[ARC_FREE];
+    pool->ghosts[entry - pool->numFrames] = pageNum;
+    frameTableInsert(pool, pageNum, entry);
+    arcLink(pool, entry, list);
+}
+
+/****************************************************************
+ * Function Name: ghostDrop 
+ * 
+ * Description: Forgets a ghost and frees its entry.
+ * 
+ * Parameter: poolInfoT, int
+ * 
+ * Return: void
+ ****************************************************************/
+static void ghostDrop(poolInfoT *pool, int entry){
+  
+    frameTableRemove(pool, entry);
+    pool->ghosts[entry - pool->numFrames] = NO_PAGE;
+    arcLink(pool, entry, ARC_FREE);
+}
+
+
+/*****Page cleaner implementation****/
+
+typedef struct cleanCandidate{
+    long long rank;      // place in the replacement order, smallest goes first
+    int frame;
+}cleanCandidateT;
+
+static int compareRank(const void *a, const void *b){
+  
+    long long x = ((const cleanCandidateT *)a)->rank, y = ((const cleanCandidateT *)b)->rank;
+    return (x > y) - (x < y);
+}
+
+/****************************************************************
+ * Function Name: cleanPass 
+ * 
+ * Description: One round of the page cleaner. When fewer than the
+ *              target number of frames are clean and unpinned, it 
+ *              writes back the dirty unpinned frames the strategy will
+ *              evict next: those the clock hand or the FIFO marker 
+ *              reaches first, otherwise the least recently used. The
+ *              writes go out in page order, without the pool lock.
+ * 
+ * Parameter: BM_BufferPool
+ * 
+ * Return: number of pages written (int)
+ ****************************************************************/
+static int cleanPass(BM_BufferPool *const bm){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    int n = bm->numPages, i, start = 0, clean, numDirty = 0, written = 0;
+    cleanCandidateT *dirty = (cleanCandidateT *)malloc(n * sizeof(cleanCandidateT));
+    pageListT *node;
+    
+    pthread_mutex_lock(&pool->lock);
+    clean = n - pool->numUsed;
+    for(i = 0; i < pool->numUsed; i++){
+      node = &pool->frames[i];
+      if(node->fixCount != 0)
+        continue;
+      if(node->dirtyBit == 0)
+        clean++;
+      else
+        dirty[numDirty++].frame = i;
+    }
+    start = (bm->strategy == RS_CLOCK) ? pool->clockHand : pool->fifoHand;
+    if(clean >= pool->cleanTarget || numDirty == 0){
+      pthread_mutex_unlock(&pool->lock);
+      free(dirty);
+      return 0;
+    }
+    
+    for(i = 0; i < numDirty; i++){
+      node = &pool->frames[dirty[i].frame];
+      if(bm->strategy == RS_CLOCK || bm->strategy == RS_FIFO)
+        dirty[i].rank = (dirty[i].frame - start + n) % n;
+      else
+        dirty[i].rank = node->hitrate;
+    }
+    qsort(dirty, numDirty, sizeof(cleanCandidateT), compareRank);
+    if(numDirty > pool->cleanTarget - clean)
+      numDirty = pool->cleanTarget - clean;
+    // Held while they are written, like forceFlushPool does.
+    for(i = 0; i < numDirty; i++){
+      node = &pool->frames[dirty[i].frame];
+      node->fixCount++;
+      if(node->heapPos >= 0)
+        heapRemove(pool, node);
+      node->dirtyBit = 0;
+      dirty[i].rank = node->pgNum;
+    }
+    pool->held += numDirty;
+    pthread_mutex_unlock(&pool->lock);
+    
+    qsort(dirty, numDirty, sizeof(cleanCandidateT), compareRank);
+    // Once written, rank tells whether the write failed.
+    for(i = 0; i < numDirty; i++){
+      node = &pool->frames[dirty[i].frame];
+      pthread_rwlock_rdlock(&node->latch);
+      dirty[i].rank = (pwriteBlock(node->pgNum, &pool->fHandle, node->data) != RC_OK);
+      pthread_rwlock_unlock(&node->latch);
+      if(dirty[i].rank == 0){
+        atomic_fetch_add_explicit(&pool->writeCount, 1, memory_order_relaxed);
+        written++;
+      }
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    for(i = 0; i < numDirty; i++){
+      node = &pool->frames[dirty[i].frame];
+      if(dirty[i].rank != 0)
+        node->dirtyBit = 1;
+      node->fixCount--;
+      if(pool->heap != NULL)
+        releaseFrame(bm, node);
+    }
+    // Pins that found every frame held wait for these.
+    pool->held -= numDirty;
+    pthread_cond_broadcast(&pool->ioDone);
+    pthread_mutex_unlock(&pool->lock);
+    free(dirty);
+    return written;
+}
+
+/****************************************************************
+ * Function Name: pageCleaner 
+ * 
+ * Description: Body of the page cleaner thread. Runs a pass every 
+ *              few milliseconds, or at once when a pin had to write
+ *              back its victim itself.
+ * 
+ * Parameter: BM_BufferPool
+ * 
+ * Return: NULL
+ ****************************************************************/
+static void *pageCleaner(void *arg){
+  
+    BM_BufferPool *bm = (BM_BufferPool *)arg;
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    struct timespec until;
+    int written;
+    
+    pthread_mutex_lock(&pool->lock);
+    while(!pool->cleanerStop){
+      pthread_mutex_unlock(&pool->lock);
+      written = cleanPass(bm);
+      pthread_mutex_lock(&pool->lock);
+      // A pass that wrote something goes again before sleeping.
+      if(written > 0 || pool->cleanerStop)
+        continue;
+      clock_gettime(CLOCK_REALTIME, &until);
+      until.tv_nsec += 10 * 1000 * 1000;
+      if(until.tv_nsec >= 1000 * 1000 * 1000){
+        until.tv_sec++;
+        until.tv_nsec -= 1000 * 1000 * 1000;
+      }
+      pthread_cond_timedwait(&pool->cleanerWake, &pool->lock, &until);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/****************************************************************
+ * Function Name: startPageCleaner 
+ * 
+ * Description: Starts a background thread writing dirty pages back
+ *              ahead of the replacement strategy, so that at least 
+ *              cleanPercent of the frames are clean and evictable and
+ *              pins rarely write their victim back themselves. It runs
+ *              until stopPageCleaner or shutdownBufferPool.
+ * 
+ * Parameter: BM_BufferPool, int
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC startPageCleaner(BM_BufferPool *const bm, int cleanPercent){
+  
+    if(bm == NULL || bm->mgmtData == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    if(pool->cleanerOn || cleanPercent <= 0 || cleanPercent > 100)
+      return RC_NOT_OK;
+    pool->cleanTarget = (bm->numPages * cleanPercent + 99) / 100;
+    pool->cleanerStop = 0;
+    if(pthread_create(&pool->cleaner, NULL, pageCleaner, bm) != 0)
+      return RC_NOT_OK;
+    pool->cleanerOn = 1;
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: stopPageCleaner 
+ * 
+ * Description: Stops the page cleaner thread and waits for it.
+ * 
+ * Parameter: BM_BufferPool
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC stopPageCleaner(BM_BufferPool *const bm){
+  
+    if(bm == NULL || bm->mgmtData == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    if(!pool->cleanerOn)
+      return RC_OK;
+    pthread_mutex_lock(&pool->lock);
+    pool->cleanerStop = 1;
+    pthread_cond_signal(&pool->cleanerWake);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_join(pool->cleaner, NULL);
+    pool->cleanerOn = 0;
+    return RC_OK;
+}
+
+
+/*****Read-ahead implementation****/
+
+/****************************************************************
+ * Function Name: prefetcher 
+ * 
+ * Description: Body of the read-ahead thread. Reads the queued pages
+ *              in queue order, each into a frame it holds only while 
+ *              reading. Pages already in the pool, or past the end of
+ *              the file, are skipped. Reading a page ahead counts as 
+ *              its first reference, its first pin does not count again.
+ * 
+ * Parameter: BM_BufferPool
+ * 
+ * Return: NULL
+ ****************************************************************/
+static void *prefetcher(void *arg){
+  
+    BM_BufferPool *bm = (BM_BufferPool *)arg;
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pageListT *node;
+    PageNumber pageNum, lastPage;
+    int numBlocks;
+    RC error;
+    
+    pthread_mutex_lock(&pool->lock);
+    while(!pool->prefetchStop){
+      if(pool->prefetchCount == 0){
+        pthread_cond_wait(&pool->prefetchWake, &pool->lock);
+        continue;
+      }
+      pageNum = pool->prefetchQueue[pool->prefetchHead];
+      pool->prefetchHead = (pool->prefetchHead + 1) % pool->numFrames;
+      pool->prefetchCount--;
+      pthread_mutex_unlock(&pool->lock);
+      numBlocks = getNumBlocks(&pool->fHandle);
+      pthread_mutex_lock(&pool->lock);
+      if(pageNum >= numBlocks || pageBusy(pool, pageNum) || frameLookup(pool, pageNum) >= 0)
+        continue;
+      // The pins around it still see their own page as the one used last.
+      lastPage = pool->lastPage;
+      if(claimFrame(bm, pageNum, &node) != RC_OK)
+        continue;
+      pool->lastPage = lastPage;
+      node->prefetched = 1;
+      pool->held++;
+      pthread_mutex_unlock(&pool->lock);
+      error = loadFrame(bm, node, pageNum);
+      if(error == RC_OK){
+        node->fixCount--;
+        if(pool->heap != NULL)
+          releaseFrame(bm, node);
+      }
+      pool->held--;
+      pthread_cond_broadcast(&pool->ioDone);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/****************************************************************
+ * Function Name: queuePrefetch 
+ * 
+ * Description: Queues count pages from firstPage on for the read-ahead
+ *              thread, starting it the first time. Resident pages are
+ *              left out, and at most a pool full of pages waits. Called
+ *              with the pool lock.
+ * 
+ * Parameter: BM_BufferPool, PageNumber, int
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+static RC queuePrefetch(BM_BufferPool *const bm, PageNumber firstPage, int count){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    int i;
+    if(!pool->prefetcherOn){
+      pool->prefetchStop = 0;
+      if(pthread_create(&pool->prefetcher, NULL, prefetcher, bm) != 0)
+        return RC_NOT_OK;
+      pool->prefetcherOn = 1;
+    }
+    for(i = 0; i < count && pool->prefetchCount < pool->numFrames; i++){
+      if(frameLookup(pool, firstPage + i) >= 0)
+        continue;
+      pool->prefetchQueue[(pool->prefetchHead + pool->prefetchCount++) % pool->numFrames] = firstPage + i;
+    }
+    pthread_cond_signal(&pool->prefetchWake);
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: readAhead 
+ * 
+ * Description: Follows the pages pinned one after the other. Once 
+ *              READ_AHEAD_RUN pins in a row went one page further each,
+ *              the next readAhead pages are queued, and topped up each
+ *              time half of them were pinned. Called with the pool lock.
+ * 
+ * Parameter: BM_BufferPool, PageNumber
+ * 
+ * Return: void
+ ****************************************************************/
+static void readAhead(BM_BufferPool *const bm, PageNumber pageNum){
+  
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    PageNumber first;
+    // Pins of the page pinned last, like a scan's, leave the run as it is.
+    if(pool->readAhead == 0 || pageNum == pool->seqLast)
+      return;
+    if(pool->seqLast != NO_PAGE && pageNum == pool->seqLast + 1)
+      pool->seqRun++;
+    else{
+      pool->seqRun = 0;
+      pool->seqAhead = pageNum;
+    }
+    pool->seqLast = pageNum;
+    if(pool->seqRun < READ_AHEAD_RUN || pool->seqAhead - pageNum > pool->readAhead / 2)
+      return;
+    first = (pool->seqAhead > pageNum) ? pool->seqAhead + 1 : pageNum + 1;
+    if(queuePrefetch(bm, first, pageNum + pool->readAhead - first + 1) == RC_OK)
+      pool->seqAhead = pageNum + pool->readAhead;
+}
+
+/****************************************************************
+ * Function Name: prefetchPages 
+ * 
+ * Description: Has count pages from firstPage on read into the pool
+ *              in the background, without pinning them, so that their
+ *              pins later find them there. Returns at once. The pages
+ *              take frames like misses do, so a scan should not ask 
+ *              for more than it uses soon.
+ * 
+ * Parameter: BM_BufferPool, PageNumber, int
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC prefetchPages(BM_BufferPool *const bm, PageNumber firstPage, int count){
+  
+    if(bm == NULL || bm->mgmtData == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    RC rc;
+    if(firstPage < 0 || count < 0)
+      return RC_READ_NON_EXISTING_PAGE;
+    pthread_mutex_lock(&pool->lock);
+    rc = queuePrefetch(bm, firstPage, count);
+    pthread_mutex_unlock(&pool->lock);
+    return rc;
+}
+
+/****************************************************************
+ * Function Name: setReadAhead 
+ * 
+ * Description: Turns on read-ahead for sequential runs of pins, up to
+ *              numPages ahead and at most half the pool, or turns it
+ *              off with 0. It is off in new pools.
+ * 
+ * Parameter: BM_BufferPool, int
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC setReadAhead(BM_BufferPool *const bm, int numPages){
+  
+    if(bm == NULL || bm->mgmtData == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    if(numPages < 0)
+      return RC_NOT_OK;
+    pthread_mutex_lock(&pool->lock);
+    pool->readAhead = (numPages > pool->numFrames / 2) ? pool->numFrames / 2 : numPages;
+    pool->seqLast = NO_PAGE;
+    pool->seqRun = 0;
+    pool->seqAhead = NO_PAGE;
+    pthread_mutex_unlock(&pool->lock);
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: stopPrefetcher 
+ * 
+ * Description: Stops the read-ahead thread, if it was started, and 
+ *              waits for it. Pages still queued are not read.
+ * 
+ * Parameter: poolInfoT
+ * 
+ * Return: void
+ ****************************************************************/
+static void stopPrefetcher(poolInfoT *pool){
+  
+    int running;
+    pthread_mutex_lock(&pool->lock);
+    running = pool->prefetcherOn;
+    pool->prefetchStop = 1;
+    pthread_cond_signal(&pool->prefetchWake);
+    pthread_mutex_unlock(&pool->lock);
+    if(running)
+      pthread_join(pool->prefetcher, NULL);
+    pool->prefetcherOn = 0;
+    pool->prefetchCount = 0;
+}
+
+
+/*****Swizzled page references implementation****/
+
+/****************************************************************
+ * Function Name: unswizzleFrame 
+ * 
+ * Description: Turns every swizzled reference to the frame back
+ *              into the page number. Called before the frame is 
+ *              given to another page.
+ * 
+ * Parameter: pageListT
+ * 
+ * Return: void
+ ****************************************************************/
+static void unswizzleFrame(pageListT *node){
+  
+    int i;
+    for(i = 0; i < node->numRefs; i++)
+      *node->refs[i] = MAKE_PAGE_REF(node->pgNum);
+    node->numRefs = 0;
+}
+
+/****************************************************************
+ * Function Name: pinPageRef 
+ * 
+ * Description: Pins the page a reference points to. A swizzled
+ *              reference leads straight to its frame. Otherwise the
+ *              page is pinned by number and the reference is swizzled
+ *              to the frame it landed in.
+ * 
+ * Parameter: BM_BufferPool, BM_PageHandle, BM_PageRef
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC pinPageRef(BM_BufferPool *const bm, BM_PageHandle *const page,
+        BM_PageRef *ref){
+  
+    if(bm == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pthread_mutex_lock(&pool->lock);
+    if(IS_SWIZZLED(*ref)){
+      pageListT *node = (pageListT *)(*ref & ~(BM_PageRef)1);
+      node->fixCount++;
+      node->refBit = 1;
+      referenceFrame(pool, node);
+      pool->hit++;
+      node->hitrate = pool->hit;
+      page->pageNum = node->pgNum;
+      page->data = node->data;
+      pthread_mutex_unlock(&pool->lock);
+      return RC_OK;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    RC error = pinPage(bm, page, getPageRefNum(*ref));
+    if(error != RC_OK)
+      return error;
+    
+    // The page is pinned, so its frame stays put while we record the slot.
+    pthread_mutex_lock(&pool->lock);
+    int frame = frameLookup(pool, page->pageNum);
+    if(frame >= 0){
+      pageListT *node = &pool->frames[frame];
+      if(node->numRefs == node->maxRefs){
+        node->maxRefs = (node->maxRefs == 0) ? 4 : node->maxRefs * 2;
+        node->refs = (BM_PageRef **)realloc(node->refs, node->maxRefs * sizeof(BM_PageRef *));
+      }
+      node->refs[node->numRefs++] = ref;
+      *ref = (BM_PageRef)node | 1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: unswizzlePageRef 
+ * 
+ * Description: Stores the page number back into a reference and 
+ *              forgets the slot. Must be called before the memory
+ *              holding a swizzled reference is freed or moved.
+ * 
+ * Parameter: BM_BufferPool, BM_PageRef
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+RC unswizzlePageRef(BM_BufferPool *const bm, BM_PageRef *ref){
+  
+    if(bm == NULL){
+      return RC_BUFFER_POOL_NOT_INIT;
+    }
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pthread_mutex_lock(&pool->lock);
+    if(IS_SWIZZLED(*ref)){
+      pageListT *node = (pageListT *)(*ref & ~(BM_PageRef)1);
+      int i;
+      for(i = 0; i < node->numRefs; i++){
+        if(node->refs[i] == ref){
+          node->refs[i] = node->refs[--node->numRefs];
+          break;
+        }
+      }
+      *ref = MAKE_PAGE_REF(node->pgNum);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: getPageRefNum 
+ * 
+ * Description: Returns the page number a reference points to, 
+ *              whether it is swizzled or not.
+ * 
+ * Parameter: BM_PageRef
+ * 
+ * Return: PageNumber
+ ****************************************************************/
+PageNumber getPageRefNum(BM_PageRef ref){
+  
+    if(IS_SWIZZLED(ref))
+      return ((pageListT *)(ref & ~(BM_PageRef)1))->pgNum;
+    return (PageNumber)(ref >> 1);
+}
+
 
 /*****Statistic Interface implementation****/
 
@@ -504,7 +2014,9 @@ RC unpinPage(BM_BufferPool * const bm, BM_PageHandle * const page) {
 
 int getNumReadIO (BM_BufferPool *const bm){
 
-       return readCount;
+       if(bm == NULL || bm->mgmtData == NULL)
+         return 0;
+       return atomic_load_explicit(&((poolInfoT *)bm->mgmtData)->readCount, memory_order_relaxed);
 
 }
 
@@ -524,7 +2036,28 @@ int getNumReadIO (BM_BufferPool *const bm){
 
 int getNumWriteIO (BM_BufferPool *const bm){
 
-          return writeCount;
+          if(bm == NULL || bm->mgmtData == NULL)
+            return 0;
+          return atomic_load_explicit(&((poolInfoT *)bm->mgmtData)->writeCount, memory_order_relaxed);
+}
+
+
+/****************************************************************
+ * Function Name: getNumEvictionWrites 
+ * 
+ * Description: Returns the number of dirty victims pins had to write
+ *              back themselves, the page cleaner keeps it low.
+ * 
+ * Parameter: BM_BufferPool.
+ * 
+ * Return: int
+ ****************************************************************/
+
+int getNumEvictionWrites (BM_BufferPool *const bm){
+
+          if(bm == NULL || bm->mgmtData == NULL)
+            return 0;
+          return atomic_load_explicit(&((poolInfoT *)bm->mgmtData)->evictWrites, memory_order_relaxed);
 }
 
 
@@ -546,13 +2079,17 @@ bool *getDirtyFlags(BM_BufferPool *const bm) {
    
     bool *flags = (bool*)malloc(sizeof(bool) * bm->numPages);
    
-    pageListT *node = (pageListT *)bm->mgmtData;
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pageListT *node = pool->frames;
    
     int i;
+    // Background threads change the frames, the copy is taken under the lock.
+    pthread_mutex_lock(&pool->lock);
     for (i = 0; i < bm->numPages; i++) {
         flags[i] = node->dirtyBit;
         node = node->next;
     }
+    pthread_mutex_unlock(&pool->lock);
 
     return flags;
 }
@@ -572,9 +2109,9 @@ bool *getDirtyFlags(BM_BufferPool *const bm) {
  ****************************************************************/
 
 int *getFixCounts(BM_BufferPool *const bm) {
-    int *fixcount = malloc(sizeof(bool) * bm->numPages);
+    int *fixcount = malloc(sizeof(int) * bm->numPages);
    
-        pageListT *node = (pageListT *)bm->mgmtData;
+        pageListT *node = ((poolInfoT *)bm->mgmtData)->frames;
    
     int i;
     for (i = 0; i < bm->numPages; i++) {
@@ -603,8 +2140,10 @@ PageNumber *getFrameContents(BM_BufferPool *const bm) {
 	
 	
     int *content = malloc(sizeof(int) * bm->numPages);
-    pageListT *node = (pageListT *)bm->mgmtData;
+    poolInfoT *pool = (poolInfoT *)bm->mgmtData;
+    pageListT *node = pool->frames;
     int i;
+    pthread_mutex_lock(&pool->lock);
     for (i = 0; i < bm->numPages; i++) {
         if (node->pgNum != NO_PAGE) {
             content[i] = node->pgNum;
@@ -613,5 +2152,6 @@ PageNumber *getFrameContents(BM_BufferPool *const bm) {
         }
         node = node->next;
     }
+    pthread_mutex_unlock(&pool->lock);
     return content;
 }
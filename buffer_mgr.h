@@ -7,6 +7,9 @@
 
 // Include bool DT
 #include "dt.h"
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 // Replacement Strategies
 typedef enum ReplacementStrategy {
@@ -14,7 +17,8 @@ typedef enum ReplacementStrategy {
   RS_LRU = 1,
   RS_CLOCK = 2,
   RS_LFU = 3,
-  RS_LRU_K = 4
+  RS_LRU_K = 4,
+  RS_ARC = 5
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -34,18 +38,96 @@ typedef struct BM_PageHandle {
   char *data;
 } BM_PageHandle;
 
+// Reference to a page stored inside another structure. While the page
+// is resident the reference is swizzled: it holds the frame pointer with
+// the low bit set. Otherwise it holds the page number shifted left by one.
+typedef uintptr_t BM_PageRef;
+
+#define MAKE_PAGE_REF(pageNum) ((BM_PageRef) (pageNum) << 1)
+#define IS_SWIZZLED(ref) (((ref) & 1) == 1)
+
 // Linked list to store pages from pagefile in memory.
 typedef struct pageList{
     SM_PageHandle data;
     int dirtyBit;
-    int fixCount;
+    atomic_int fixCount; // unpinPage drops pins without the pool lock
     PageNumber pgNum;
     int useCount;
-    int fifoBit;
     int hitrate;
+    int refBit;          // set on every pin, cleared by the clock hand
+    int refCount;        // references since the page came in, for RS_LFU
+    long long heapKey;   // eviction order of the heap strategies, smallest goes
+    int heapPos;         // place in the eviction heap, -1 while pinned
+    int io;              // set while the page is read in, pins of it wait
+    PageNumber writePage;  // evicted dirty page the reading pin writes first
+    int prefetched;      // read ahead and not pinned since
+    pthread_rwlock_t latch;  // guards the page content, see latchPage
+    BM_PageRef **refs;   // swizzled references to this frame
+    int numRefs;
+    int maxRefs;
     struct pageList *next;
 }pageListT;
 
+// Pools are aligned to this, their I/O counters get a line of their own.
+#define CACHE_LINE_SIZE 64
+
+// RS_ARC lists: resident pages used once and more than once, the ghosts
+// of pages evicted from either, and the unused ghost entries.
+enum { ARC_T1, ARC_T2, ARC_B1, ARC_B2, ARC_FREE, ARC_LISTS };
+
+// Bookkeeping of one buffer pool, bm->mgmtData points to it.
+typedef struct poolInfo{
+    pageListT *frames;   // numPages frame descriptors, linked in array order
+    int numFrames;
+    char *arena;         // page aligned, frame i holds its page at i * PAGE_SIZE
+    SM_FileHandle fHandle;  // the page file, open from init to shutdown
+    pthread_mutex_t lock;   // guards the table and the replacement state
+    pthread_cond_t ioDone;  // signalled whenever a frame's I/O finishes
+    int held;               // frames held by flushes and background threads
+    pthread_t cleaner;      // background writer, see startPageCleaner
+    int cleanerOn;
+    int cleanerStop;
+    int cleanTarget;        // clean unpinned frames the cleaner keeps
+    pthread_cond_t cleanerWake;
+    pthread_t prefetcher;   // read-ahead thread, started by the first prefetch
+    int prefetcherOn;
+    int prefetchStop;
+    pthread_cond_t prefetchWake;
+    PageNumber *prefetchQueue;  // ring of pages waiting to be read ahead
+    int prefetchHead;
+    int prefetchCount;
+    int readAhead;          // pages pinPage reads ahead of a sequential run
+    PageNumber seqLast;     // page pinned last, for spotting sequential runs
+    int seqRun;             // pins in a row that went one page further
+    PageNumber seqAhead;    // last page queued ahead of the run
+    int numUsed;         // frames holding a page, they are filled in order
+    int *table;          // open addressing, page number -> frame index
+    int tableMask;       // table size - 1, the size is a power of two
+    int clockHand;       // next frame RS_CLOCK looks at
+    int fifoHand;        // oldest frame, the next RS_FIFO victim
+    pageListT **heap;    // unpinned frames by heapKey, RS_LRU, RS_LFU and RS_LRU_K only
+    int heapSize;
+    int k;               // references remembered per frame
+    long long *history;  // k reference times per frame, latest first
+    long long tick;      // advanced on every reference
+    long long age;       // key of the last RS_LFU victim, ages the counts
+    PageNumber lastPage; // page referenced last
+    PageNumber *ghosts;  // RS_ARC only, page of table entry numFrames + i
+                         // entry 2 * numFrames + i is the writePage of frame i
+    int *arcList;        // list of each frame and ghost entry, -1 for none
+    int *arcPrev;        // towards the most recently used end
+    int *arcNext;
+    int arcHead[ARC_LISTS];  // most recently used entry of each list
+    int arcTail[ARC_LISTS];
+    int arcSize[ARC_LISTS];
+    int arcTarget;       // size of ARC_T1 the policy aims for
+    int hit;             // pins so far, the time stamp of RS_LRU
+    // Updated without the pool mutex, relaxed atomics are enough.
+    _Alignas(CACHE_LINE_SIZE) atomic_int readCount;
+    atomic_int writeCount;
+    atomic_int evictWrites;  // write backs done by pins themselves
+}poolInfoT;
+
 // convenience macros
 #define MAKE_POOL()					\
   ((BM_BufferPool *) malloc (sizeof(BM_BufferPool)))
@@ -59,8 +141,11 @@ RC initBufferPool(BM_BufferPool *const bm, char *pageFileName,
 		  void *stratData);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
-//RC initPageFrame(pageListT** head_ref);
-RC initPageFrame(pageListT* head_ref);
+RC initPageFrame(pageListT* frame);
+RC startPageCleaner(BM_BufferPool *const bm, int cleanPercent);
+RC stopPageCleaner(BM_BufferPool *const bm);
+RC prefetchPages(BM_BufferPool *const bm, PageNumber firstPage, int count);
+RC setReadAhead(BM_BufferPool *const bm, int numPages);
 //void printlist(pageListT* node);
 
 // Buffer Manager Interface Access Pages
@@ -70,11 +155,23 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 	    const PageNumber pageNum);
 
+// Content latches of pinned pages, shared or exclusive
+RC latchPage (BM_BufferPool *const bm, BM_PageHandle *const page,
+	    bool exclusive);
+RC unlatchPage (BM_BufferPool *const bm, BM_PageHandle *const page);
+
+// Swizzled page references
+RC pinPageRef (BM_BufferPool *const bm, BM_PageHandle *const page,
+	    BM_PageRef *ref);
+RC unswizzlePageRef (BM_BufferPool *const bm, BM_PageRef *ref);
+PageNumber getPageRefNum (BM_PageRef ref);
+
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
 bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+int getNumEvictionWrites (BM_BufferPool *const bm);
 
 #endif
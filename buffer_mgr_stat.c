@@ -98,6 +98,9 @@ printStrat (BM_BufferPool *const bm)
     case RS_LRU_K:
       printf("LRU-K");
       break;
+    case RS_ARC:
+      printf("ARC");
+      break;
     default:
       printf("%i", bm->strategy);
       break;
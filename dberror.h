@@ -35,6 +35,8 @@ typedef int RC;
 #define RC_IM_KEY_ALREADY_EXISTS 301
 #define RC_IM_N_TO_LAGE 302
 #define RC_IM_NO_MORE_ENTRIES 303
+#define RC_IM_NO_PAYLOAD 304
+#define RC_IM_READ_ONLY 305
 
 #define RC_CREATE_TABLE_FAILED 401
 #define RC_TABLE_NOT_FOUND 402
@@ -2,8 +2,30 @@
 #include<stdlib.h>
 #include<string.h>
 #include<math.h>
+#include<pthread.h>
 #include "record_mgr.h"
 
+#define MAX_INDEXES 8
+#define INDEX_NAME_SIZE 32
+#define INDEX_ORDER 32
+#define INDEX_BTREE 0
+#define INDEX_BITMAP 1
+#define SCAN_READ_AHEAD 4
+
+/**
+ * A secondary index registered for the table. B+-tree entries are keyed
+ * on (attribute value, page, slot) so equal attribute values stay unique,
+ * a bitmap index keeps one bitmap of rows per attribute value.
+ **/
+typedef struct Table_Index {
+  char name[INDEX_NAME_SIZE];
+  int attrNum;
+  int kind;
+  int offset;
+  BTreeHandle *tree;
+  BitmapHandle *bitmap;
+}Table_Index;
+
 /**
  * The table metadata has important attributes. It also has a the
  * buffer pool for the table.
@@ -13,6 +35,10 @@ typedef struct Table_Metadata {
   int numPages;
   int freePage;
   BM_BufferPool bm;
+  int indexOffset;
+  int numIndexes;
+  Table_Index indexes[MAX_INDEXES];
+  int heapScans;  // open scans walking every page, they turn read-ahead on
 }Table_Metadata;
 Table_Metadata *metaD;
 
@@ -23,11 +49,18 @@ typedef struct Scan_Metadata {
   RID id;
   Expr *cond;
   int scannedRecords;	
+  RID *rids;      // rows picked through an index, NULL for a heap scan
+  int numRids;
+  int nextRid;
 }Scan_Metadata;
 //int insertCount;
 
 // Utilitiy to print schema.
 void printSchema(RM_TableData *rel);
+int getAttrOffset(Schema *schema, int attrNum);
+int attrSize(Schema *schema, int attrNum);
+RC buildIndex(RM_TableData *rel, Table_Index *index, int nThreads);
+RC nextIndexed(RM_ScanHandle *scan, Record *record);
 
 /***Table and Manager methods****/
 
@@ -110,6 +143,8 @@ extern RC createTable (char *name, Schema *schema){
     *(int*)info = (int) schema->typeLength[i];
     info += sizeof(int); 
   }
+  // No indexes registered yet.
+  *(int *)info = 0;
   
   //Creating a table and the metadata and schema on the disk.
   if(createPageFile(name) != RC_OK)
@@ -150,6 +185,7 @@ extern RC openTable (RM_TableData *rel, char *name){
   
   //Initializing buffer pool for the given table.
   initBufferPool(&metaD->bm, name, 10, RS_FIFO, NULL);
+  metaD->heapScans = 0;
   rc = pinPage(&metaD->bm, pHandle, 0);
   if(rc != RC_OK)	
 	 return RC_CREATE_TABLE_FAILED;
@@ -190,11 +226,49 @@ extern RC openTable (RM_TableData *rel, char *name){
   
   rel->name = name;
   rel->schema = sc;
+  
+  // Extracting the indexes registered for the table and opening them.
+  metaD->indexOffset = info - pHandle->data;
+  metaD->numIndexes = *(int *)info;
+  info += sizeof(int);
+  for(i = 0; i < metaD->numIndexes; i++){
+    strncpy(metaD->indexes[i].name, info, INDEX_NAME_SIZE);
+    info += INDEX_NAME_SIZE;
+    metaD->indexes[i].attrNum = *(int *)info;
+    info += sizeof(int);
+    metaD->indexes[i].kind = *(int *)info;
+    info += sizeof(int);
+  }
   unpinPage(&metaD->bm, pHandle);
   
+  // B+-trees are rebuilt from the rows, bitmaps are read back from disk.
+  for(i = 0; i < metaD->numIndexes; i++){
+    if(metaD->indexes[i].kind == INDEX_BITMAP){
+      metaD->indexes[i].tree = NULL;
+      metaD->indexes[i].offset = getAttrOffset(sc, metaD->indexes[i].attrNum);
+      rc = openBitmapIndex(&metaD->indexes[i].bitmap, metaD->indexes[i].name);
+    }
+    else
+      rc = buildIndex(rel, &metaD->indexes[i], 1);
+    if(rc != RC_OK)
+      break;
+  }
+  
+  // Close what was opened so far if an index could not be loaded.
+  if(rc != RC_OK){
+    while(--i >= 0){
+      if(metaD->indexes[i].kind == INDEX_BITMAP)
+        closeBitmapIndex(metaD->indexes[i].bitmap);
+      else
+        closeBtree(metaD->indexes[i].tree);
+    }
+    shutdownBufferPool(&metaD->bm);
+    rel->mgmtData = NULL;
+  }
+  
   //Free allocated space
   free(pHandle);
-  return RC_OK;
+  return rc;
 }
 
 void printSchema(RM_TableData *rel){
@@ -236,8 +310,15 @@ extern RC closeTable (RM_TableData *rel){
   BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
   char *info = (char *)malloc(PAGE_SIZE);
   RC rc;
+  int i;
  
   metaD = rel->mgmtData;
+  for(i = 0; i < metaD->numIndexes; i++){
+    if(metaD->indexes[i].kind == INDEX_BITMAP)
+      closeBitmapIndex(metaD->indexes[i].bitmap);
+    else
+      closeBtree(metaD->indexes[i].tree);
+  }
   pinPage(&metaD->bm, pHandle, 0);
   info = pHandle->data;
   *(int *)info = metaD->numTuples;
@@ -306,6 +387,672 @@ extern int getNumTuples (RM_TableData *rel){
     
 }
 
+/***** Methods dealing with indexes *****/
+
+/****************************************************************
+ * Function Name: getAttrOffset
+ * 
+ * Description: Offset of an attribute inside the record data.
+ * 
+ * Parameter: Schema *, int
+ * 
+ * Return: offset (int)
+ ****************************************************************/
+int getAttrOffset(Schema *schema, int attrNum){
+  
+  int offset = 0, i;
+  for(i = 0; i < attrNum; i++)
+    offset+= attrSize(schema, i);
+  return offset;
+}
+
+/****************************************************************
+ * Function Name: attrSize
+ * 
+ * Description: Number of bytes an attribute takes in a record.
+ * 
+ * Parameter: Schema *, int
+ * 
+ * Return: size (int)
+ ****************************************************************/
+int attrSize(Schema *schema, int attrNum){
+  
+  if(schema->dataTypes[attrNum] == DT_INT)
+    return sizeof(int);
+  else if(schema->dataTypes[attrNum] == DT_FLOAT)
+    return sizeof(float);
+  else if(schema->dataTypes[attrNum] == DT_BOOL)
+    return sizeof(bool);
+  return schema->typeLength[attrNum];
+}
+
+/****************************************************************
+ * Function Name: makeIndexKey
+ * 
+ * Description: Fills the key columns of a row for an index: the 
+ *              attribute read from the record data, then the page 
+ *              and slot of the row. A string attribute is copied to
+ *              str, which needs room for its typeLength bytes and a
+ *              terminator.
+ * 
+ * Parameter: Table_Index *, Schema *, char *, RID, Value *, char *
+ * 
+ * Return: --
+ ****************************************************************/
+void makeIndexKey(Table_Index *index, Schema *schema, char *data, RID id, Value *vals, char *str){
+  
+  char *info = data + index->offset;
+  
+  vals[0].dt = schema->dataTypes[index->attrNum];
+  switch(vals[0].dt){
+    case DT_INT:
+      memcpy(&vals[0].v.intV, info, sizeof(int));
+      break;
+    case DT_FLOAT:
+      memcpy(&vals[0].v.floatV, info, sizeof(float));
+      break;
+    case DT_BOOL:
+      memcpy(&vals[0].v.boolV, info, sizeof(bool));
+      break;
+    case DT_STRING:
+      // a value filling its column has no terminator in the record
+      memcpy(str, info, schema->typeLength[index->attrNum]);
+      str[schema->typeLength[index->attrNum]] = '\0';
+      vals[0].v.stringV = str;
+      break;
+  }
+  vals[1].dt = DT_INT;
+  vals[1].v.intV = id.page;
+  vals[2].dt = DT_INT;
+  vals[2].v.intV = id.slot;
+}
+
+/****************************************************************
+ * Function Name: indexRecord
+ * 
+ * Description: Adds (insert = true) or removes the entry of a row in
+ *              one index, or sets or clears its bit in a bitmap index.
+ * 
+ * Parameter: Table_Index *, Schema *, char *, RID, bool
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+RC indexRecord(Table_Index *index, Schema *schema, char *data, RID id, bool insert){
+  
+  Value vals[3];
+  Value *key[3] = { &vals[0], &vals[1], &vals[2] };
+  char str[schema->typeLength[index->attrNum] + 1];
+  
+  makeIndexKey(index, schema, data, id, vals, str);
+  if(index->kind == INDEX_BITMAP){
+    if(insert)
+      return setBitmapEntry(index->bitmap, &vals[0], id);
+    return clearBitmapEntry(index->bitmap, &vals[0], id);
+  }
+  if(insert)
+    return insertCompositeKey(index->tree, key, id);
+  return deleteCompositeKey(index->tree, key);
+}
+
+/****************************************************************
+ * Function Name: indexKeyChanged
+ * 
+ * Description: Tells whether the value one index is built on differs
+ *              between the old row (NULL if there is none) and the 
+ *              new one.
+ * 
+ * Parameter: Table_Index *, Schema *, char *, char *
+ * 
+ * Return: bool
+ ****************************************************************/
+bool indexKeyChanged(Table_Index *index, Schema *schema, char *oldData, char *newData){
+  
+  return oldData == NULL || memcmp(oldData + index->offset, newData + index->offset,
+      attrSize(schema, index->attrNum)) != 0;
+}
+
+/****************************************************************
+ * Function Name: rekeyRecord
+ * 
+ * Description: Moves the entry of a row in one index from its old 
+ *              values (NULL for a row that was not there) to the new
+ *              ones. If adding the new entry fails, the old one is 
+ *              put back, so the index is left as it was.
+ * 
+ * Parameter: Table_Index *, Schema *, char *, char *, RID
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+RC rekeyRecord(Table_Index *index, Schema *schema, char *oldData, char *newData, RID id){
+  
+  RC rc;
+  
+  if(oldData != NULL){
+    rc = indexRecord(index, schema, oldData, id, false);
+    if(rc != RC_OK)
+      return rc;
+  }
+  rc = indexRecord(index, schema, newData, id, true);
+  if(rc != RC_OK && oldData != NULL)
+    indexRecord(index, schema, oldData, id, true);
+  return rc;
+}
+
+/****************************************************************
+ * Function Name: writeIndexList
+ * 
+ * Description: Saves the indexes of the table on the header page,
+ *              right after the schema.
+ * 
+ * Parameter: Table_Metadata *
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+RC writeIndexList(Table_Metadata *metaD){
+  
+  BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
+  char *info;
+  int i;
+  
+  pinPage(&metaD->bm, pHandle, 0);
+  info = pHandle->data + metaD->indexOffset;
+  *(int *)info = metaD->numIndexes;
+  info += sizeof(int);
+  for(i = 0; i < metaD->numIndexes; i++){
+    strncpy(info, metaD->indexes[i].name, INDEX_NAME_SIZE);
+    info += INDEX_NAME_SIZE;
+    *(int *)info = metaD->indexes[i].attrNum;
+    info += sizeof(int);
+    *(int *)info = metaD->indexes[i].kind;
+    info += sizeof(int);
+  }
+  markDirty(&metaD->bm, pHandle);
+  unpinPage(&metaD->bm, pHandle);
+  free(pHandle);
+  return RC_OK;
+}
+
+/**
+ * Work of one thread in a parallel index build: the pages it reads and
+ * the sorted run of entries it produces.
+ **/
+typedef struct Index_Build {
+  RM_TableData *rel;
+  Table_Index *index;
+  int firstPage;
+  int lastPage;
+  int keySize;
+  char *keys;
+  Btree_entry *entries;
+  int numEntries;
+  RC rc;
+}Index_Build;
+
+/**
+ * One merge of two neighbouring sorted runs into out.
+ **/
+typedef struct Index_Merge {
+  Btree_entry *left;
+  int numLeft;
+  Btree_entry *right;
+  int numRight;
+  Btree_entry *out;
+  int keySize;
+}Index_Merge;
+
+/****************************************************************
+ * Function Name: mergeEntries
+ * 
+ * Description: Merges two runs sorted by key into out.
+ * 
+ * Parameter: Index_Merge *
+ * 
+ * Return: --
+ ****************************************************************/
+void mergeEntries(Index_Merge *m){
+  
+  int i = 0, j = 0, k = 0;
+  while(i < m->numLeft && j < m->numRight){
+    if(memcmp(m->left[i].key, m->right[j].key, m->keySize) <= 0)
+      m->out[k++] = m->left[i++];
+    else
+      m->out[k++] = m->right[j++];
+  }
+  while(i < m->numLeft)
+    m->out[k++] = m->left[i++];
+  while(j < m->numRight)
+    m->out[k++] = m->right[j++];
+}
+
+/****************************************************************
+ * Function Name: sortEntries
+ * 
+ * Description: Merge sort of entries by key, tmp has room for n.
+ * 
+ * Parameter: Btree_entry *, Btree_entry *, int, int
+ * 
+ * Return: --
+ ****************************************************************/
+void sortEntries(Btree_entry *entries, Btree_entry *tmp, int n, int keySize){
+  
+  Index_Merge m;
+  int half = n / 2;
+  
+  if(n < 2)
+    return;
+  sortEntries(entries, tmp, half, keySize);
+  sortEntries(entries + half, tmp + half, n - half, keySize);
+  m.left = entries;
+  m.numLeft = half;
+  m.right = entries + half;
+  m.numRight = n - half;
+  m.out = tmp;
+  m.keySize = keySize;
+  mergeEntries(&m);
+  memcpy(entries, tmp, n * sizeof(Btree_entry));
+}
+
+/****************************************************************
+ * Function Name: extractEntries
+ * 
+ * Description: Thread body of a parallel index build. Reads its pages
+ *              through its own file handle, so workers never share 
+ *              the buffer pool, and sorts the entries it found.
+ * 
+ * Parameter: Index_Build * (as void *)
+ * 
+ * Return: NULL, the outcome is left in work->rc
+ ****************************************************************/
+void *extractEntries(void *arg){
+  
+  Index_Build *work = arg;
+  Schema *sc = work->rel->schema;
+  SM_FileHandle fHandle;
+  char *page = (char *)malloc(PAGE_SIZE);
+  int recordSize = getRecordSize(sc) + 1;
+  int totalNumSlots = PAGE_SIZE/recordSize;
+  int capacity = (work->lastPage - work->firstPage + 1) * totalNumSlots;
+  Value vals[3];
+  Value *key[3] = { &vals[0], &vals[1], &vals[2] };
+  char str[sc->typeLength[work->index->attrNum] + 1];
+  Btree_entry *entry, *tmp;
+  char *info;
+  RID id;
+  
+  work->keys = (char *)malloc(capacity * work->keySize + 1);
+  work->entries = (Btree_entry *)malloc(capacity * sizeof(Btree_entry) + 1);
+  work->numEntries = 0;
+  work->rc = openPageFile(work->rel->name, &fHandle);
+  if(work->rc != RC_OK){
+    free(page);
+    return NULL;
+  }
+  for(id.page = work->firstPage; id.page <= work->lastPage; id.page++){
+    // pages past the end of the file hold no rows yet
+    work->rc = readBlock(id.page, &fHandle, page);
+    if(work->rc != RC_OK){
+      if(work->rc == RC_READ_NON_EXISTING_PAGE)
+        work->rc = RC_OK;
+      break;
+    }
+    for(id.slot = 0; id.slot < totalNumSlots; id.slot++){
+      info = page + id.slot * recordSize;
+      if(*info != '*')
+        continue;
+      entry = &work->entries[work->numEntries];
+      entry->key = work->keys + work->numEntries * work->keySize;
+      work->numEntries++;
+      entry->size = work->keySize;
+      entry->rid = id;
+      makeIndexKey(work->index, sc, info + 1, id, vals, str);
+      work->rc = encodeKey(work->index->tree, key, entry->key);
+      if(work->rc != RC_OK)
+        break;
+    }
+    if(work->rc != RC_OK)
+      break;
+  }
+  closePageFile(&fHandle);
+  free(page);
+  
+  tmp = (Btree_entry *)malloc(work->numEntries * sizeof(Btree_entry) + 1);
+  sortEntries(work->entries, tmp, work->numEntries, work->keySize);
+  free(tmp);
+  return NULL;
+}
+
+/****************************************************************
+ * Function Name: mergeWorker
+ * 
+ * Description: Thread body for one merge of a parallel merge round.
+ ****************************************************************/
+void *mergeWorker(void *arg){
+  
+  mergeEntries((Index_Merge *)arg);
+  return NULL;
+}
+
+/****************************************************************
+ * Function Name: buildIndex
+ * 
+ * Description: (Re)creates the B+-tree of an index and loads every
+ *              row of the table into it. The data pages are split 
+ *              among nThreads workers that extract and sort (key, RID)
+ *              pairs. The sorted runs are merged pairwise in parallel
+ *              rounds and the tree is built bottom-up from the result.
+ *              B+-tree nodes only live in memory, so openTable 
+ *              rebuilds each registered index.
+ * 
+ * Parameter: RM_TableData *, Table_Index *, int
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+RC buildIndex(RM_TableData *rel, Table_Index *index, int nThreads){
+  
+  Table_Metadata *metaD = rel->mgmtData;
+  Schema *sc = rel->schema;
+  DataType keyTypes[3] = { DT_INT, DT_INT, DT_INT };
+  int keyLengths[3] = { 0, 0, 0 };
+  int keyAttrs[3] = { 0, 1, 2 };
+  Schema keySchema;
+  Index_Build *work;
+  Index_Merge *merges;
+  pthread_t *threads;
+  Btree_entry *all, *buf, *swap;
+  int *runStart, *runLen;
+  int i, numRuns, numMerges, total, perThread;
+  RC rc;
+  
+  // Key columns: the attribute, then page and slot of the row.
+  keyTypes[0] = sc->dataTypes[index->attrNum];
+  keyLengths[0] = sc->typeLength[index->attrNum];
+  keySchema.numAttr = 3;
+  keySchema.attrNames = NULL;
+  keySchema.dataTypes = keyTypes;
+  keySchema.typeLength = keyLengths;
+  keySchema.keyAttrs = keyAttrs;
+  keySchema.keySize = 3;
+  
+  index->offset = getAttrOffset(sc, index->attrNum);
+  rc = createCompositeBtree(index->name, INDEX_ORDER, &keySchema);
+  if(rc != RC_OK)
+    return rc;
+  rc = openBtree(&index->tree, index->name);
+  if(rc != RC_OK)
+    return rc;
+  
+  // Workers read the page file directly, it has to be current.
+  rc = forceFlushPool(&metaD->bm);
+  if(rc != RC_OK){
+    closeBtree(index->tree);
+    index->tree = NULL;
+    return rc;
+  }
+  if(nThreads > metaD->numPages)
+    nThreads = metaD->numPages;
+  if(nThreads < 1)
+    nThreads = 1;
+  
+  work = (Index_Build *)malloc(nThreads * sizeof(Index_Build));
+  threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+  perThread = metaD->numPages / nThreads;
+  for(i = 0; i < nThreads; i++){
+    work[i].rel = rel;
+    work[i].index = index;
+    work[i].firstPage = 1 + i * perThread + (i < metaD->numPages % nThreads ? i : metaD->numPages % nThreads);
+    work[i].lastPage = work[i].firstPage + perThread - 1 + (i < metaD->numPages % nThreads ? 1 : 0);
+    getKeySize(index->tree, &work[i].keySize);
+    pthread_create(&threads[i], NULL, extractEntries, &work[i]);
+  }
+  for(i = 0; i < nThreads; i++)
+    pthread_join(threads[i], NULL);
+  for(i = 0; i < nThreads; i++){
+    if(work[i].rc != RC_OK)
+      rc = work[i].rc;
+  }
+  if(rc != RC_OK){
+    for(i = 0; i < nThreads; i++){
+      free(work[i].keys);
+      free(work[i].entries);
+    }
+    free(work);
+    free(threads);
+    closeBtree(index->tree);
+    index->tree = NULL;
+    return rc;
+  }
+  
+  // Lay the sorted runs out next to each other.
+  total = 0;
+  for(i = 0; i < nThreads; i++)
+    total += work[i].numEntries;
+  all = (Btree_entry *)malloc(total * sizeof(Btree_entry) + 1);
+  buf = (Btree_entry *)malloc(total * sizeof(Btree_entry) + 1);
+  runStart = (int *)malloc(nThreads * sizeof(int));
+  runLen = (int *)malloc(nThreads * sizeof(int));
+  merges = (Index_Merge *)malloc(nThreads * sizeof(Index_Merge));
+  total = 0;
+  for(i = 0; i < nThreads; i++){
+    memcpy(all + total, work[i].entries, work[i].numEntries * sizeof(Btree_entry));
+    runStart[i] = total;
+    runLen[i] = work[i].numEntries;
+    total += work[i].numEntries;
+  }
+  
+  // Merge neighbouring runs in parallel until one is left.
+  numRuns = nThreads;
+  while(numRuns > 1){
+    numMerges = numRuns / 2;
+    for(i = 0; i < numMerges; i++){
+      merges[i].left = all + runStart[2 * i];
+      merges[i].numLeft = runLen[2 * i];
+      merges[i].right = all + runStart[2 * i + 1];
+      merges[i].numRight = runLen[2 * i + 1];
+      merges[i].out = buf + runStart[2 * i];
+      merges[i].keySize = work[0].keySize;
+      pthread_create(&threads[i], NULL, mergeWorker, &merges[i]);
+    }
+    if(numRuns % 2 == 1)
+      memcpy(buf + runStart[numRuns - 1], all + runStart[numRuns - 1],
+          runLen[numRuns - 1] * sizeof(Btree_entry));
+    for(i = 0; i < numMerges; i++)
+      pthread_join(threads[i], NULL);
+    for(i = 0; i < numRuns / 2; i++){
+      runStart[i] = runStart[2 * i];
+      runLen[i] = runLen[2 * i] + runLen[2 * i + 1];
+    }
+    if(numRuns % 2 == 1){
+      runStart[i] = runStart[numRuns - 1];
+      runLen[i] = runLen[numRuns - 1];
+    }
+    numRuns = (numRuns + 1) / 2;
+    swap = all;
+    all = buf;
+    buf = swap;
+  }
+  
+  rc = bulkLoadKeys(index->tree, all, total);
+  
+  for(i = 0; i < nThreads; i++){
+    free(work[i].keys);
+    free(work[i].entries);
+  }
+  free(work);
+  free(threads);
+  free(all);
+  free(buf);
+  free(runStart);
+  free(runLen);
+  free(merges);
+  if(rc != RC_OK){
+    closeBtree(index->tree);
+    index->tree = NULL;
+  }
+  return rc;
+}
+
+/****************************************************************
+ * Function Name: buildIndexOnTable
+ * 
+ * Description: Creates a B+-tree index on one attribute of the table,
+ *              loads the rows already in the table using nThreads 
+ *              workers and registers it, so that openTable opens it 
+ *              and insertRecord, updateRecord and deleteRecord keep 
+ *              it up to date.
+ * 
+ * Parameter: RM_TableData *, int, char *, int
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+extern RC buildIndexOnTable (RM_TableData *rel, int attrNum, char *idxId, int nThreads){
+  
+  Table_Metadata *metaD = rel->mgmtData;
+  Table_Index *index;
+  RC rc;
+  
+  if(attrNum < 0 || attrNum >= rel->schema->numAttr)
+    return RC_NO_SUCH_ATTRIBUTE_IN_TABLE;
+  if(metaD->numIndexes == MAX_INDEXES || strlen(idxId) >= INDEX_NAME_SIZE)
+    return RC_NOT_OK;
+  
+  index = &metaD->indexes[metaD->numIndexes];
+  memset(index->name, 0, INDEX_NAME_SIZE);
+  strcpy(index->name, idxId);
+  index->attrNum = attrNum;
+  index->kind = INDEX_BTREE;
+  index->bitmap = NULL;
+  rc = buildIndex(rel, index, nThreads);
+  if(rc != RC_OK)
+    return rc;
+  
+  metaD->numIndexes++;
+  return writeIndexList(metaD);
+}
+
+/****************************************************************
+ * Function Name: createIndex
+ * 
+ * Description: Single threaded buildIndexOnTable.
+ * 
+ * Parameter: RM_TableData *, char *, int
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+extern RC createIndex (RM_TableData *rel, char *idxId, int attrNum){
+  
+  return buildIndexOnTable(rel, attrNum, idxId, 1);
+}
+
+/****************************************************************
+ * Function Name: getIndex
+ * 
+ * Description: Looks up an index of the table by name.
+ * 
+ * Parameter: RM_TableData *, char *, BTreeHandle **
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+extern RC getIndex (RM_TableData *rel, char *idxId, BTreeHandle **tree){
+  
+  Table_Metadata *metaD = rel->mgmtData;
+  int i;
+  
+  for(i = 0; i < metaD->numIndexes; i++){
+    if(metaD->indexes[i].kind == INDEX_BTREE && strcmp(metaD->indexes[i].name, idxId) == 0){
+      *tree = metaD->indexes[i].tree;
+      return RC_OK;
+    }
+  }
+  return RC_IM_KEY_NOT_FOUND;
+}
+
+/****************************************************************
+ * Function Name: createBitmapIndexOnTable
+ * 
+ * Description: Creates a bitmap index on a low cardinality attribute
+ *              of the table, one bitmap of rows per distinct value, 
+ *              sets the bits of the rows already in the table and 
+ *              registers it like buildIndexOnTable does.
+ * 
+ * Parameter: RM_TableData *, int, char *
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+extern RC createBitmapIndexOnTable (RM_TableData *rel, int attrNum, char *idxId){
+  
+  Table_Metadata *metaD = rel->mgmtData;
+  BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
+  int recordSize = getRecordSize(rel->schema) + 1;
+  Table_Index *index;
+  char *info;
+  RID id;
+  RC rc;
+  
+  if(attrNum < 0 || attrNum >= rel->schema->numAttr)
+    return RC_NO_SUCH_ATTRIBUTE_IN_TABLE;
+  if(metaD->numIndexes == MAX_INDEXES || strlen(idxId) >= INDEX_NAME_SIZE)
+    return RC_NOT_OK;
+  
+  index = &metaD->indexes[metaD->numIndexes];
+  memset(index->name, 0, INDEX_NAME_SIZE);
+  strcpy(index->name, idxId);
+  index->attrNum = attrNum;
+  index->kind = INDEX_BITMAP;
+  index->offset = getAttrOffset(rel->schema, attrNum);
+  index->tree = NULL;
+  rc = createBitmapIndex(index->name, rel->schema->dataTypes[attrNum],
+      attrSize(rel->schema, attrNum), PAGE_SIZE / recordSize);
+  if(rc != RC_OK)
+    return rc;
+  rc = openBitmapIndex(&index->bitmap, index->name);
+  if(rc != RC_OK)
+    return rc;
+  
+  // Set the bit of every live row.
+  for(id.page = 1; id.page <= metaD->numPages; id.page++){
+    pinPage(&metaD->bm, pHandle, id.page);
+    for(id.slot = 0; id.slot < PAGE_SIZE / recordSize; id.slot++){
+      info = pHandle->data + id.slot * recordSize;
+      if(*info == '*' && (rc = indexRecord(index, rel->schema, info + 1, id, true)) != RC_OK)
+        break;
+    }
+    unpinPage(&metaD->bm, pHandle);
+    if(rc != RC_OK){
+      closeBitmapIndex(index->bitmap);
+      deleteBitmapIndex(index->name);
+      free(pHandle);
+      return rc;
+    }
+  }
+  free(pHandle);
+  
+  metaD->numIndexes++;
+  return writeIndexList(metaD);
+}
+
+/****************************************************************
+ * Function Name: getBitmapIndex
+ * 
+ * Description: Looks up a bitmap index of the table by name.
+ * 
+ * Parameter: RM_TableData *, char *, BitmapHandle **
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+extern RC getBitmapIndex (RM_TableData *rel, char *idxId, BitmapHandle **index){
+  
+  Table_Metadata *metaD = rel->mgmtData;
+  int i;
+  
+  for(i = 0; i < metaD->numIndexes; i++){
+    if(metaD->indexes[i].kind == INDEX_BITMAP && strcmp(metaD->indexes[i].name, idxId) == 0){
+      *index = metaD->indexes[i].bitmap;
+      return RC_OK;
+    }
+  }
+  return RC_IM_KEY_NOT_FOUND;
+}
+
 /***** Methods dealing with records and tables *****/
 
 /****************************************************************
@@ -324,13 +1071,15 @@ extern RC insertRecord (RM_TableData *rel, Record *record){
 	Table_Metadata *metaD = rel->mgmtData;
 	BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
 	char *info = (char *)malloc(PAGE_SIZE);
+	RC rc = RC_OK;
 
 	// Setting the page of the record to the first free page.
 	record->id.page = metaD->freePage;
 	
 	// Pin the first available free page.
 	pinPage(&metaD->bm, pHandle, record->id.page);
-	int recordSize = getRecordSize(rel->schema);
+	// A slot holds the tombstone byte followed by the record data.
+	int recordSize = getRecordSize(rel->schema) + 1;
 	info = pHandle->data;
 	
 	// Find first available empty slot in the free page.
@@ -371,9 +1120,28 @@ extern RC insertRecord (RM_TableData *rel, Record *record){
 	unpinPage(&metaD->bm, pHandle);
 	metaD->numTuples++;
 	
+	// Add the new row to every index of the table.
+	for(i = 0; i < metaD->numIndexes; i++){
+	  rc = indexRecord(&metaD->indexes[i], rel->schema, record->data, record->id, true);
+	  if(rc != RC_OK)
+	    break;
+	}
+	
+	// Take the row out again if one of the indexes refused it.
+	if(rc != RC_OK){
+	  while(--i >= 0)
+	    indexRecord(&metaD->indexes[i], rel->schema, record->data, record->id, false);
+	  pinPage(&metaD->bm, pHandle, record->id.page);
+	  pHandle->data[record->id.slot * recordSize] = '+';
+	  markDirty(&metaD->bm, pHandle);
+	  unpinPage(&metaD->bm, pHandle);
+	  metaD->freePage = record->id.page;
+	  metaD->numTuples--;
+	}
+	
 	// Free allocated memory
 	free(pHandle);
-	return RC_OK;
+	return rc;
 }
 
 /****************************************************************
@@ -394,18 +1162,38 @@ extern RC deleteRecord (RM_TableData *rel, RID id){
     Table_Metadata *metaD = rel->mgmtData;
 	BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
 	char *info = (char *)malloc(PAGE_SIZE);
+	RC rc = RC_OK;
+	int i;
 	
 	// Extract the page from which we have to delete the record.
 	pinPage(&metaD->bm, pHandle, id.page);
 	info = pHandle->data;
 	
-	//Fetch record size from the schema
-	int recordSize = getRecordSize(rel->schema);
+	//Fetch slot size: the tombstone byte followed by the record data.
+	int recordSize = getRecordSize(rel->schema) + 1;
 	
 	// Find the offset of the record to be deleted.
 	int offset = recordSize * id.slot;
 	info+= offset;
 	
+	// Drop the row from the indexes while its old values are still here.
+	// If one of them fails the others get their entry back and the row
+	// stays.
+	if(*info == '*'){
+	  for(i = 0; i < metaD->numIndexes; i++){
+	    rc = indexRecord(&metaD->indexes[i], rel->schema, info + 1, id, false);
+	    if(rc != RC_OK)
+	      break;
+	  }
+	  if(rc != RC_OK){
+	    while(--i >= 0)
+	      indexRecord(&metaD->indexes[i], rel->schema, info + 1, id, true);
+	    unpinPage(&metaD->bm, pHandle);
+	    free(pHandle);
+	    return rc;
+	  }
+	}
+	
 	// Mark a tombstone on the record to indicate that it is a free slot 
 	// and can be used by insertRecord method to insert new record.
 	*info = '+';
@@ -442,18 +1230,49 @@ extern RC updateRecord (RM_TableData *rel, Record *record){
     Table_Metadata *metaD = rel->mgmtData;
 	BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
 	char *info = (char *)malloc(PAGE_SIZE);
+	Table_Index *index;
+	char *oldData;
+	RC rc = RC_OK;
+	int i;
 	
 	// Extract the page from which we have to update the record.
 	pinPage(&metaD->bm, pHandle, record->id.page);
 	info = pHandle->data;
 	
-	//Fetch record size from the schema
-	int recordSize = getRecordSize(rel->schema);
+	//Fetch slot size: the tombstone byte followed by the record data.
+	int recordSize = getRecordSize(rel->schema) + 1;
 	
 	// Find the offset of the record to be updated.
 	int offset = recordSize * record->id.slot;
 	info+= offset;
 	
+	// Re-key only the indexes whose column changed.
+	oldData = (*info == '*') ? info + 1 : NULL;
+	for(i = 0; i < metaD->numIndexes; i++){
+	  index = &metaD->indexes[i];
+	  if(!indexKeyChanged(index, rel->schema, oldData, record->data))
+	    continue;
+	  rc = rekeyRecord(index, rel->schema, oldData, record->data, record->id);
+	  if(rc != RC_OK)
+	    break;
+	}
+	
+	// rekeyRecord left the failed index as it was, move the ones done
+	// before it back to the old values and keep the old row.
+	if(rc != RC_OK){
+	  while(--i >= 0){
+	    index = &metaD->indexes[i];
+	    if(!indexKeyChanged(index, rel->schema, oldData, record->data))
+	      continue;
+	    indexRecord(index, rel->schema, record->data, record->id, false);
+	    if(oldData != NULL)
+	      indexRecord(index, rel->schema, oldData, record->id, true);
+	  }
+	  unpinPage(&metaD->bm, pHandle);
+	  free(pHandle);
+	  return rc;
+	}
+	
 	// used for tombstone purpose. '*' indicates active record. 
 	*info = '*';
 	info++;
@@ -492,8 +1311,8 @@ extern RC getRecord (RM_TableData *rel, RID id, Record *record){
 	pinPage(&metaD->bm, pHandle, id.page);
 	info = pHandle->data;
 	
-	//Fetch record size from the schema
-	int recordSize = getRecordSize(rel->schema);
+	//Fetch slot size: the tombstone byte followed by the record data.
+	int recordSize = getRecordSize(rel->schema) + 1;
 	
 	// Find the offset of the record to be fetched.
 	int offset = recordSize * id.slot;
@@ -520,6 +1339,421 @@ extern RC getRecord (RM_TableData *rel, RID id, Record *record){
 
 /** Methods for scanning **/
 
+/****************************************************************
+ * Function Name: indexRange
+ * 
+ * Description: Looks for a comparison of an indexed attribute with a
+ *              constant in the condition (possibly under AND or NOT)
+ *              and turns it into an index range. lo or hi stay NULL
+ *              for an open end. The range may be wider than the 
+ *              condition, next still evaluates it on every row.
+ * 
+ * Parameter: Table_Metadata *, Schema *, Expr *, Table_Index **,
+ *            Value **, Value **
+ * 
+ * Return: true when an index can drive the scan (bool)
+ ****************************************************************/
+bool indexRange(Table_Metadata *metaD, Schema *schema, Expr *cond,
+    Table_Index **index, Value **lo, Value **hi){
+  
+  Operator *op;
+  Expr *attr, *cons;
+  bool negate = false, attrLeft;
+  int i;
+  
+  if(cond->type != EXPR_OP)
+    return false;
+  op = cond->expr.op;
+  if(op->type == OP_BOOL_AND)
+    return indexRange(metaD, schema, op->args[0], index, lo, hi)
+        || indexRange(metaD, schema, op->args[1], index, lo, hi);
+  if(op->type == OP_BOOL_NOT){
+    if(op->args[0]->type != EXPR_OP)
+      return false;
+    op = op->args[0]->expr.op;
+    negate = true;
+  }
+  if(op->type != OP_COMP_EQUAL && op->type != OP_COMP_SMALLER)
+    return false;
+  if(negate && op->type == OP_COMP_EQUAL)
+    return false;
+  
+  // One side has to be the attribute and the other one a constant.
+  attrLeft = op->args[0]->type == EXPR_ATTRREF;
+  attr = attrLeft ? op->args[0] : op->args[1];
+  cons = attrLeft ? op->args[1] : op->args[0];
+  if(attr->type != EXPR_ATTRREF || cons->type != EXPR_CONST)
+    return false;
+  if(schema->dataTypes[attr->expr.attrRef] != cons->expr.cons->dt)
+    return false;
+  
+  for(i = 0; i < metaD->numIndexes; i++){
+    if(metaD->indexes[i].kind == INDEX_BTREE && metaD->indexes[i].attrNum == attr->expr.attrRef)
+      break;
+  }
+  if(i == metaD->numIndexes)
+    return false;
+  *index = &metaD->indexes[i];
+  
+  // attr < c and NOT(c < attr) bound from above, the others from below.
+  if(op->type == OP_COMP_EQUAL){
+    *lo = cons->expr.cons;
+    *hi = cons->expr.cons;
+  }
+  else if(attrLeft != negate){
+    *lo = NULL;
+    *hi = cons->expr.cons;
+  }
+  else{
+    *lo = cons->expr.cons;
+    *hi = NULL;
+  }
+  return true;
+}
+
+/****************************************************************
+ * Function Name: bitmapRows
+ * 
+ * Description: Answers the condition with the bitmap indexes of the
+ *              table: an equality of an indexed attribute and a 
+ *              constant is the bitmap of that value, AND, OR and NOT 
+ *              combine the bitmaps of their arguments a word at a 
+ *              time. Under AND one answerable side is enough, the 
+ *              rows are then a superset (exact = false) and next 
+ *              evaluates the condition on each of them anyway. OR 
+ *              needs both sides, NOT an exact argument.
+ * 
+ * Parameter: Table_Metadata *, Schema *, Expr *, Bitmap **, bool *
+ * 
+ * Return: true when the bitmaps can drive the scan (bool)
+ ****************************************************************/
+bool bitmapRows(Table_Metadata *metaD, Schema *schema, Expr *cond,
+    Bitmap **rows, bool *exact){
+  
+  Operator *op;
+  Expr *attr, *cons;
+  Bitmap *left, *right;
+  bool leftExact, rightExact, hasLeft, hasRight;
+  int i;
+  
+  if(cond->type != EXPR_OP)
+    return false;
+  op = cond->expr.op;
+  switch(op->type){
+    case OP_BOOL_AND:
+    case OP_BOOL_OR:
+      hasLeft = bitmapRows(metaD, schema, op->args[0], &left, &leftExact);
+      hasRight = bitmapRows(metaD, schema, op->args[1], &right, &rightExact);
+      if(hasLeft && hasRight){
+        if(op->type == OP_BOOL_AND)
+          bitmapAnd(left, right);
+        else
+          bitmapOr(left, right);
+        freeBitmap(right);
+        *rows = left;
+        *exact = leftExact && rightExact;
+        return true;
+      }
+      if(op->type == OP_BOOL_AND && (hasLeft || hasRight)){
+        *rows = hasLeft ? left : right;
+        *exact = false;
+        return true;
+      }
+      if(hasLeft)
+        freeBitmap(left);
+      if(hasRight)
+        freeBitmap(right);
+      return false;
+    case OP_BOOL_NOT:
+      if(!bitmapRows(metaD, schema, op->args[0], rows, exact))
+        return false;
+      if(!*exact){
+        freeBitmap(*rows);
+        return false;
+      }
+      bitmapNot(*rows, 1, metaD->numPages);
+      return true;
+    case OP_COMP_EQUAL:
+      break;
+    default:
+      return false;
+  }
+  
+  // One side has to be the attribute and the other one a constant.
+  attr = (op->args[0]->type == EXPR_ATTRREF) ? op->args[0] : op->args[1];
+  cons = (op->args[0]->type == EXPR_ATTRREF) ? op->args[1] : op->args[0];
+  if(attr->type != EXPR_ATTRREF || cons->type != EXPR_CONST)
+    return false;
+  if(schema->dataTypes[attr->expr.attrRef] != cons->expr.cons->dt)
+    return false;
+  for(i = 0; i < metaD->numIndexes; i++){
+    if(metaD->indexes[i].kind == INDEX_BITMAP && metaD->indexes[i].attrNum == attr->expr.attrRef){
+      getValueBitmap(metaD->indexes[i].bitmap, cons->expr.cons, rows);
+      *exact = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+/****************************************************************
+ * Function Name: compareRids
+ * 
+ * Description: qsort callback, orders RIDs by page then slot.
+ ****************************************************************/
+int compareRids(const void *a, const void *b){
+  
+  const RID *left = a, *right = b;
+  if(left->page != right->page)
+    return (left->page > right->page) - (left->page < right->page);
+  return (left->slot > right->slot) - (left->slot < right->slot);
+}
+
+/****************************************************************
+ * Function Name: collectRids
+ * 
+ * Description: Runs the index range scan and keeps the RIDs, sorted
+ *              by page so each page is pinned once in a row.
+ * 
+ * Parameter: Table_Index *, Value *, Value *, RID **, int *
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+RC collectRids(Table_Index *index, Value *lo, Value *hi, RID **rids, int *numRids){
+  
+  BT_ScanHandle *sc;
+  int size = 16;
+  RC rc;
+  
+  rc = openRangeScan(index->tree, (lo == NULL) ? NULL : &lo, 
+      (hi == NULL) ? NULL : &hi, 1, &sc);
+  if(rc != RC_OK)
+    return rc;
+  *rids = (RID *)malloc(size * sizeof(RID));
+  *numRids = 0;
+  while(nextEntry(sc, &(*rids)[*numRids]) == RC_OK){
+    (*numRids)++;
+    if(*numRids == size){
+      size *= 2;
+      *rids = (RID *)realloc(*rids, size * sizeof(RID));
+    }
+  }
+  closeTreeScan(sc);
+  qsort(*rids, *numRids, sizeof(RID), compareRids);
+  return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: gallopRids
+ * 
+ * Description: First position from lo on whose RID is not below id,
+ *              in a sorted list. Probes 1, 2, 4, ... entries ahead 
+ *              and then searches the last step, so walking a short 
+ *              list against a long one skips most of the long one.
+ * 
+ * Parameter: RID *, int, int, RID *
+ * 
+ * Return: position (int)
+ ****************************************************************/
+int gallopRids(RID *rids, int lo, int n, RID *id){
+  
+  int hi = lo, step = 1, mid;
+  
+  while(hi < n && compareRids(&rids[hi], id) < 0){
+    lo = hi + 1;
+    hi += step;
+    step *= 2;
+  }
+  if(hi > n)
+    hi = n;
+  while(lo < hi){
+    mid = (lo + hi) / 2;
+    if(compareRids(&rids[mid], id) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/****************************************************************
+ * Function Name: intersectRids
+ * 
+ * Description: Keeps the RIDs of the shorter sorted list that are also
+ *              in the longer one, galloping through the longer list.
+ *              The result replaces the shorter list, the other one is
+ *              freed.
+ * 
+ * Parameter: RID **, int *, RID *, int
+ * 
+ * Return: --
+ ****************************************************************/
+void intersectRids(RID **rids, int *numRids, RID *other, int numOther){
+  
+  RID *small = *rids, *big = other, *swap;
+  int numSmall = *numRids, numBig = numOther;
+  int i, j = 0, n = 0;
+  
+  if(numSmall > numBig){
+    swap = small; small = big; big = swap;
+    numSmall = numOther;
+    numBig = *numRids;
+  }
+  for(i = 0; i < numSmall && j < numBig; i++){
+    j = gallopRids(big, j, numBig, &small[i]);
+    if(j < numBig && compareRids(&big[j], &small[i]) == 0)
+      small[n++] = small[i];
+  }
+  free(big);
+  *rids = small;
+  *numRids = n;
+}
+
+/****************************************************************
+ * Function Name: unionRids
+ * 
+ * Description: Merges two sorted RID lists into one without
+ *              duplicates, both inputs are freed.
+ * 
+ * Parameter: RID **, int *, RID *, int
+ * 
+ * Return: --
+ ****************************************************************/
+void unionRids(RID **rids, int *numRids, RID *other, int numOther){
+  
+  RID *out = (RID *)malloc((*numRids + numOther + 1) * sizeof(RID));
+  int i = 0, j = 0, n = 0, cmp;
+  
+  while(i < *numRids || j < numOther){
+    if(i == *numRids)
+      cmp = 1;
+    else if(j == numOther)
+      cmp = -1;
+    else
+      cmp = compareRids(&(*rids)[i], &other[j]);
+    if(cmp <= 0)
+      out[n++] = (*rids)[i++];
+    else
+      out[n++] = other[j++];
+    if(cmp == 0)
+      j++;
+  }
+  free(*rids);
+  free(other);
+  *rids = out;
+  *numRids = n;
+}
+
+/****************************************************************
+ * Function Name: mergeRids
+ * 
+ * Description: Index merge. Collects the candidate rows of the
+ *              condition from every index that can answer a part of
+ *              it: exact bitmap answers are taken whole, an AND 
+ *              intersects the RID lists of its answerable sides and 
+ *              an OR unions them when both sides are answerable. 
+ *              The lists stay sorted by page and slot, next fetches 
+ *              the rows in that order and evaluates the condition.
+ * 
+ * Parameter: Table_Metadata *, Schema *, Expr *, RID **, int *
+ * 
+ * Return: true when indexes can drive the scan (bool)
+ ****************************************************************/
+bool mergeRids(Table_Metadata *metaD, Schema *schema, Expr *cond,
+    RID **rids, int *numRids){
+  
+  Table_Index *index;
+  Value *lo = NULL, *hi = NULL;
+  Bitmap *rows;
+  RID *other;
+  int numOther;
+  bool exact, hasLeft, hasRight;
+  Operator *op;
+  
+  if(cond->type != EXPR_OP)
+    return false;
+  if(bitmapRows(metaD, schema, cond, &rows, &exact)){
+    if(exact){
+      bitmapToRids(rows, rids, numRids);
+      freeBitmap(rows);
+      return true;
+    }
+    freeBitmap(rows);
+  }
+  
+  op = cond->expr.op;
+  if(op->type == OP_BOOL_AND || op->type == OP_BOOL_OR){
+    hasLeft = mergeRids(metaD, schema, op->args[0], rids, numRids);
+    hasRight = mergeRids(metaD, schema, op->args[1], &other, &numOther);
+    if(hasLeft && hasRight){
+      if(op->type == OP_BOOL_AND)
+        intersectRids(rids, numRids, other, numOther);
+      else
+        unionRids(rids, numRids, other, numOther);
+      return true;
+    }
+    if(op->type == OP_BOOL_AND && hasRight){
+      *rids = other;
+      *numRids = numOther;
+      return true;
+    }
+    if(op->type == OP_BOOL_AND && hasLeft)
+      return true;
+    if(hasLeft)
+      free(*rids);
+    if(hasRight)
+      free(other);
+    return false;
+  }
+  
+  if(!indexRange(metaD, schema, cond, &index, &lo, &hi))
+    return false;
+  return collectRids(index, lo, hi, rids, numRids) == RC_OK;
+}
+
+/****************************************************************
+ * Function Name: nextIndexed
+ * 
+ * Description: next for scans driven by an index. Walks the collected
+ *              RIDs and returns the live rows matching the condition.
+ * 
+ * Parameter: RM_ScanHandle, Record
+ * 
+ * Return: Error code (RC)
+ ****************************************************************/
+RC nextIndexed(RM_ScanHandle *scan, Record *record){
+  
+  Table_Metadata *metaD = scan->rel->mgmtData;
+  Scan_Metadata *scanD = scan->mgmtData;
+  BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
+  int recordSize = getRecordSize(scan->rel->schema) + 1;
+  Value *result;
+  char *info;
+  RID id;
+  bool match;
+  
+  while(scanD->nextRid < scanD->numRids){
+    id = scanD->rids[scanD->nextRid++];
+    pinPage(&metaD->bm, pHandle, id.page);
+    info = pHandle->data + id.slot * recordSize;
+    match = false;
+    if(*info == '*'){
+      memcpy(record->data, info + 1, recordSize - 1);
+      record->id = id;
+      evalExpr(record, scan->rel->schema, scanD->cond, &result);
+      match = result->v.boolV;
+      freeVal(result);
+    }
+    unpinPage(&metaD->bm, pHandle);
+    if(match){
+      free(pHandle);
+      return RC_OK;
+    }
+  }
+  free(pHandle);
+  return RC_RM_NO_MORE_TUPLES;
+}
+
 /****************************************************************
  * Function Name: startScan
  * 
@@ -533,13 +1767,25 @@ extern RC getRecord (RM_TableData *rel, RID id, Record *record){
  ****************************************************************/
 extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond){
   
-    //Table_Metadata *metaD = rel->mgmtData;
+    Table_Metadata *metaD = rel->mgmtData;
     Scan_Metadata *scanD = (Scan_Metadata *)malloc(sizeof(Scan_Metadata));
 	
 	// Initialize RID to the first record.
 	scanD->id.page = 1;
 	scanD->id.slot = 0;
 	scanD->scannedRecords = 0;
+	scanD->rids = NULL;
+	scanD->numRids = 0;
+	scanD->nextRid = 0;
+	
+	// Fetch only the candidate rows when indexes cover the condition.
+	if(cond != NULL && !mergeRids(metaD, rel->schema, cond, &scanD->rids, &scanD->numRids))
+	  scanD->rids = NULL;
+	
+	// Otherwise every page is read in order, so the next ones are read
+	// ahead while any such scan is open.
+	if(scanD->rids == NULL && metaD->heapScans++ == 0)
+	  setReadAhead(&metaD->bm, SCAN_READ_AHEAD);
 	
 	// Save the given condition in the scan metadata
 	scanD->cond = cond;
@@ -567,6 +1813,9 @@ extern RC next (RM_ScanHandle *scan, Record *record){
   Table_Metadata  *metaD = scan->rel->mgmtData;
   Scan_Metadata   *scanD = scan->mgmtData;
   
+  if(scanD->rids != NULL)
+    return nextIndexed(scan, record);
+  
   char *info = (char *)malloc(PAGE_SIZE);
   BM_PageHandle *pHandle = MAKE_PAGE_HANDLE();
   
@@ -574,7 +1823,8 @@ extern RC next (RM_ScanHandle *scan, Record *record){
   int numberOfTuples = metaD->numTuples;
   
   // Get total number of slots in a block.   
-  int recordSize = getRecordSize(scan->rel->schema); 
+  // A slot holds the tombstone byte followed by the record data.
+  int recordSize = getRecordSize(scan->rel->schema) + 1;
   int totalNumSlots = PAGE_SIZE/recordSize;
   
   if(numberOfTuples == 0)
@@ -696,6 +1946,15 @@ extern RC closeScan (RM_ScanHandle *scan){
      scanD->scannedRecords = 0;
   } 
   
+  // Point lookups and index scans should not read pages ahead.
+  if(scanD->rids == NULL){
+    Table_Metadata *metaD = scan->rel->mgmtData;
+    if(--metaD->heapScans == 0)
+      setReadAhead(&metaD->bm, 0);
+  }
+  
+  free(scanD->rids);
+  free(scanD);
   scan->mgmtData = NULL;
   return RC_OK;
 }
@@ -871,8 +2130,8 @@ extern RC getAttr (Record *record, Schema *schema, int attrNum, Value **value){
 	    }
 		break;
 		case DT_STRING:{
-		  val->v.stringV = (char *)malloc(sizeof(schema->typeLength[attrNum] + 1));
-		  strncpy(val->v.stringV, info, sizeof(schema->typeLength[attrNum]));
+		  val->v.stringV = (char *)malloc(schema->typeLength[attrNum] + 1);
+		  strncpy(val->v.stringV, info, schema->typeLength[attrNum]);
 		  val->v.stringV[schema->typeLength[attrNum]] = '\0';
 	    }
 		break;
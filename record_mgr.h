@@ -6,6 +6,8 @@
 #include "tables.h"
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
+#include "btree_mgr.h"
+#include "bitmap_mgr.h"
 
 // Bookkeeping for scans
 typedef struct RM_ScanHandle
@@ -25,6 +27,13 @@ extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
 extern int getNumTuples (RM_TableData *rel);
 
+// secondary indexes, maintained by insertRecord/updateRecord/deleteRecord
+extern RC createIndex (RM_TableData *rel, char *idxId, int attrNum);
+extern RC buildIndexOnTable (RM_TableData *rel, int attrNum, char *idxId, int nThreads);
+extern RC getIndex (RM_TableData *rel, char *idxId, BTreeHandle **tree);
+extern RC createBitmapIndexOnTable (RM_TableData *rel, int attrNum, char *idxId);
+extern RC getBitmapIndex (RM_TableData *rel, char *idxId, BitmapHandle **index);
+
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
 extern RC deleteRecord (RM_TableData *rel, RID id);
@@ -1,6 +1,8 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
+#include<unistd.h>
+#include<sys/stat.h>
 #include "dberror.h"
 #include "storage_mgr.h"
 
@@ -486,3 +488,93 @@ extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
 	fHandle->curPagePos = fHandle->curPagePos + 1;
     return RC_OK;
 }
+
+/****************************************************************
+ * Function Name: preadBlock
+ * 
+ * Description: Reads the pageNumth block of the file with a single
+ *              positional read, past the stdio buffer. The handle is 
+ *              left as it is, so threads can share it. The end of the
+ *              file is found by the read, so pages appended through 
+ *              other handles are seen.
+ * 
+ * Parameter: int, SM_FileHandle, SM_PageHandle
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+extern RC preadBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage){
+  
+  ssize_t n;
+  if(fHandle == NULL || fHandle->mgmtInfo == NULL){
+	  return RC_FILE_HANDLE_NOT_INIT;
+  }
+  if(pageNum < 0){
+	  return RC_READ_NON_EXISTING_PAGE;
+  }
+  
+  n = pread(fileno(fHandle->mgmtInfo), memPage, PAGE_SIZE, (off_t)pageNum * PAGE_SIZE);
+  if(n < 0){
+	  return RC_READ_ERROR;
+  }
+  if(n == 0){
+	  return RC_READ_NON_EXISTING_PAGE;
+  }
+  // A partly written last page reads as zeros after its end.
+  if(n < PAGE_SIZE){
+	  memset(memPage + n, 0, PAGE_SIZE - n);
+  }
+  return RC_OK;
+}
+
+/****************************************************************
+ * Function Name: getNumBlocks
+ * 
+ * Description: Returns the number of blocks in the file right now, 
+ *              from the file itself rather than the handle, so pages
+ *              appended through other handles are counted.
+ * 
+ * Parameter: SM_FileHandle
+ * 
+ * Return: int, -1 without an open file
+ ****************************************************************/
+extern int getNumBlocks (SM_FileHandle *fHandle){
+  
+  struct stat st;
+  if(fHandle == NULL || fHandle->mgmtInfo == NULL){
+	  return -1;
+  }
+  if(fstat(fileno(fHandle->mgmtInfo), &st) != 0){
+	  return -1;
+  }
+  return (int)((st.st_size + PAGE_SIZE - 1) / PAGE_SIZE);
+}
+
+/****************************************************************
+ * Function Name: pwriteBlock
+ * 
+ * Description: Writes memPage to the pageNumth block of the file with
+ *              a single positional write, past the stdio buffer. The 
+ *              handle is left as it is, so threads can share it. A 
+ *              page past the end grows the file, the pages between 
+ *              read as zeros.
+ * 
+ * Parameter: int, SM_FileHandle, SM_PageHandle
+ * 
+ * Return: RC (int)
+ ****************************************************************/
+extern RC pwriteBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage){
+  
+  ssize_t n;
+  if(fHandle == NULL || fHandle->mgmtInfo == NULL){
+	  return RC_FILE_HANDLE_NOT_INIT;
+  }
+  if(pageNum < 0){
+	  return RC_WRITE_FAILED;
+  }
+  
+  n = pwrite(fileno(fHandle->mgmtInfo), memPage, PAGE_SIZE, (off_t)pageNum * PAGE_SIZE);
+  if(n != PAGE_SIZE){
+	  return RC_WRITE_FAILED;
+  }
+  return RC_OK;
+}
@@ -1,8 +1,18 @@
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "dberror.h"
 #include "expr.h"
 #include "btree_mgr.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "record_mgr.h"
 #include "tables.h"
 #include "test_helper.h"
 
@@ -15,6 +25,33 @@
 static void testInsertAndFind (void);
 static void testDelete (void);
 static void testIndexScan (void);
+static void testSequentialInsert (void);
+static void testBatchInsert (void);
+static void testDeleteRange (void);
+static void testUpsert (void);
+static void testCoveringIndex (void);
+static void testCompositeKey (void);
+static void testLongStringKeys (void);
+static void testTableIndexes (void);
+static void testIndexedScan (void);
+static void testParallelIndexBuild (void);
+static void testSnapshot (void);
+static void testPageRefs (void);
+static void testScanPosition (void);
+static void testBitmapIndex (void);
+static void testIndexMerge (void);
+static void testFrameTable (void);
+static void testFrameArena (void);
+static void testClock (void);
+static void testLfuLruK (void);
+static void testArc (void);
+static void testPoolFile (void);
+static void testPoolStats (void);
+static void testConcurrentPool (void);
+static void testPageCleaner (void);
+static void testPrefetch (void);
+static void testWriteErrors (void);
+static void testReadErrors (void);
 
 // helper methods
 static Value **createValues (char **stringVals, int size);
@@ -33,6 +70,33 @@ main (void)
   testInsertAndFind();
   testDelete();
   testIndexScan();
+  testSequentialInsert();
+  testBatchInsert();
+  testDeleteRange();
+  testUpsert();
+  testCoveringIndex();
+  testCompositeKey();
+  testLongStringKeys();
+  testTableIndexes();
+  testIndexedScan();
+  testParallelIndexBuild();
+  testSnapshot();
+  testPageRefs();
+  testScanPosition();
+  testBitmapIndex();
+  testIndexMerge();
+  testFrameTable();
+  testFrameArena();
+  testClock();
+  testLfuLruK();
+  testArc();
+  testPoolFile();
+  testPoolStats();
+  testConcurrentPool();
+  testPageCleaner();
+  testPrefetch();
+  testWriteErrors();
+  testReadErrors();
 
   return 0;
 }
@@ -265,6 +329,2289 @@ testIndexScan (void)
   TEST_DONE();
 }
 
+// ************************************************************ 
+void
+testSequentialInsert (void)
+{
+  int numInserts = 20;
+  int i, testint, rc;
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  RID rid;
+  Value key;
+
+  testName = "sequential insertion fills leaves";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_INT, 2));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // ascending keys take the right-edge append path
+  key.dt = DT_INT;
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = i % 3;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+
+  // 10 full leaves plus 8 inner nodes; a 50/50 split would need 19 leaves
+  TEST_CHECK(getNumNodes(tree, &testint));
+  ASSERT_EQUALS_INT(18, testint, "number of nodes in btree");
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(numInserts, testint, "number of entries in btree");
+
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = i;
+      TEST_CHECK(findKey(tree, &key, &rid));
+      ASSERT_TRUE(rid.page == i && rid.slot == i % 3, "did we find the correct RID?");
+    }
+
+  openTreeScan(tree, &sc);
+  i = 0;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    ASSERT_TRUE(rid.page == i++, "scan returns entries in key order");
+  ASSERT_EQUALS_INT(numInserts, i, "have seen all entries");
+  closeTreeScan(sc);
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testBatchInsert (void)
+{
+  int numKeys = 40;
+  int i, testint, rc;
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  Value **keys = (Value **) malloc(sizeof(Value *) * numKeys);
+  RID *rids = (RID *) malloc(sizeof(RID) * numKeys);
+  int *permute;
+  RID rid;
+  Value key;
+
+  testName = "batch insert into existing index";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_INT, 3));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // even keys one at a time, odd keys as one shuffled batch
+  key.dt = DT_INT;
+  for(i = 0; i < numKeys; i += 2)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+  permute = createPermutation(numKeys / 2);
+  for(i = 0; i < numKeys / 2; i++)
+    {
+      MAKE_VALUE(keys[i], DT_INT, 2 * permute[i] + 1);
+      rids[i].page = 2 * permute[i] + 1;
+      rids[i].slot = 0;
+    }
+  // an existing key in the batch is ignored
+  MAKE_VALUE(keys[numKeys / 2], DT_INT, 4);
+  rids[numKeys / 2].page = -1;
+  rids[numKeys / 2].slot = -1;
+  TEST_CHECK(insertKeys(tree, keys, rids, numKeys / 2 + 1));
+
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(numKeys, testint, "number of entries in btree");
+  for(i = 0; i < numKeys; i++)
+    {
+      key.v.intV = i;
+      TEST_CHECK(findKey(tree, &key, &rid));
+      ASSERT_TRUE(rid.page == i, "did we find the correct RID?");
+    }
+
+  openTreeScan(tree, &sc);
+  i = 0;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    ASSERT_TRUE(rid.page == i++, "scan returns entries in key order");
+  ASSERT_EQUALS_INT(numKeys, i, "have seen all entries");
+  closeTreeScan(sc);
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+  freeValues(keys, numKeys / 2 + 1);
+  free(rids);
+  free(permute);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testDeleteRange (void)
+{
+  int numInserts = 50;
+  int i, testint, nodesBefore, rc;
+  BTreeHandle *tree = NULL;
+  RID rid;
+  Value key, lo, hi;
+
+  testName = "range delete";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_INT, 3));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  key.dt = DT_INT;
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+  TEST_CHECK(getNumNodes(tree, &nodesBefore));
+
+  // drop [10, 29], whole leaves in the middle go away
+  lo.dt = hi.dt = DT_INT;
+  lo.v.intV = 10;
+  hi.v.intV = 29;
+  TEST_CHECK(deleteRange(tree, &lo, &hi));
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(numInserts - 20, testint, "number of entries in btree");
+  TEST_CHECK(getNumNodes(tree, &testint));
+  ASSERT_TRUE(testint < nodesBefore, "empty leaves were released");
+
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = i;
+      rc = findKey(tree, &key, &rid);
+      if (i >= 10 && i <= 29)
+        ASSERT_TRUE((rc == RC_IM_KEY_NOT_FOUND), "entry was deleted, should not find it");
+      else
+        {
+          TEST_CHECK(rc);
+          ASSERT_TRUE(rid.page == i, "did we find the correct RID?");
+        }
+    }
+
+  // the range can be filled again
+  for(i = 10; i < 30; i++)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = i;
+      TEST_CHECK(findKey(tree, &key, &rid));
+      ASSERT_TRUE(rid.page == i, "did we find the correct RID?");
+    }
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testUpsert (void)
+{
+  int numInserts = 12;
+  int i, testint, nodesBefore;
+  BTreeHandle *tree = NULL;
+  RID rid, oldRid;
+  Value key;
+  bool existed;
+
+  testName = "upsert";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_INT, 2));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // even keys are new
+  key.dt = DT_INT;
+  for(i = 0; i < numInserts; i += 2)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = 0;
+      TEST_CHECK(upsertKey(tree, &key, rid, &oldRid, &existed));
+      ASSERT_TRUE(!existed, "key was not in the index yet");
+    }
+  TEST_CHECK(getNumNodes(tree, &nodesBefore));
+
+  // replacing keeps the node and entry counts
+  for(i = 0; i < numInserts; i += 2)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = 1;
+      TEST_CHECK(upsertKey(tree, &key, rid, &oldRid, &existed));
+      ASSERT_TRUE(existed, "key was replaced");
+      ASSERT_TRUE(oldRid.page == i && oldRid.slot == 0, "old RID is returned");
+    }
+  TEST_CHECK(getNumNodes(tree, &testint));
+  ASSERT_EQUALS_INT(nodesBefore, testint, "number of nodes in btree");
+
+  // odd keys land between existing entries
+  for(i = 1; i < numInserts; i += 2)
+    {
+      key.v.intV = i;
+      rid.page = i;
+      rid.slot = 1;
+      TEST_CHECK(upsertKey(tree, &key, rid, NULL, NULL));
+    }
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(numInserts, testint, "number of entries in btree");
+
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = i;
+      TEST_CHECK(findKey(tree, &key, &rid));
+      ASSERT_TRUE(rid.page == i && rid.slot == 1, "did we find the correct RID?");
+    }
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testCoveringIndex (void)
+{
+  int numInserts = 10;
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+  int sizes[] = { 0, 4, 0 };
+  int keyAttrs[] = { 0 };
+  int covered[] = { 2, 1 };
+  char str[12];
+  int i, testint, rc;
+  Schema *schema;
+  Record *record;
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  Value *key, *values[2];
+  RID rid;
+
+  testName = "covering index returns payload columns";
+
+  schema = createSchema(3, names, dt, sizes, 1, keyAttrs);
+  TEST_CHECK(createRecord(&record, schema));
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createCoveringBtree("testidx", DT_INT, 3, schema, 2, covered));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+  TEST_CHECK(getNumCoveredAttrs(tree, &testint));
+  ASSERT_EQUALS_INT(2, testint, "number of covered attributes");
+
+  // insert in reverse so entries move through splits
+  for(i = numInserts - 1; i >= 0; i--)
+    {
+      MAKE_VALUE(key, DT_INT, i);
+      TEST_CHECK(setAttr(record, schema, 0, key));
+      freeVal(key);
+      sprintf(str, "s%03i", i);
+      MAKE_STRING_VALUE(key, str);
+      TEST_CHECK(setAttr(record, schema, 1, key));
+      freeVal(key);
+      MAKE_VALUE(key, DT_INT, i * 10);
+      TEST_CHECK(setAttr(record, schema, 2, key));
+      freeVal(key);
+
+      MAKE_VALUE(key, DT_INT, i);
+      rid.page = 1;
+      rid.slot = i;
+      TEST_CHECK(insertCoveringKey(tree, key, rid, record));
+      free(key);
+    }
+
+  MAKE_VALUE(key, DT_INT, 7);
+  TEST_CHECK(findCoveringKey(tree, key, &rid, values));
+  ASSERT_EQUALS_INT(7, rid.slot, "did we find the correct RID?");
+  ASSERT_EQUALS_INT(70, values[0]->v.intV, "covered int column");
+  ASSERT_EQUALS_STRING("s007", values[1]->v.stringV, "covered string column");
+  freeVal(values[0]);
+  freeVal(values[1]);
+  free(key);
+
+  openTreeScan(tree, &sc);
+  i = 0;
+  while((rc = nextCoveringEntry(sc, &rid, values)) == RC_OK)
+    {
+      sprintf(str, "s%03i", i);
+      ASSERT_TRUE(rid.slot == i, "scan returns entries in key order");
+      ASSERT_TRUE(values[0]->v.intV == i * 10, "covered int column");
+      ASSERT_EQUALS_STRING(str, values[1]->v.stringV, "covered string column");
+      freeVal(values[0]);
+      freeVal(values[1]);
+      i++;
+    }
+  ASSERT_EQUALS_INT(RC_IM_NO_MORE_ENTRIES, rc, "no error returned by scan");
+  ASSERT_EQUALS_INT(numInserts, i, "have seen all entries");
+  closeTreeScan(sc);
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+  freeRecord(record);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testCompositeKey (void)
+{
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+  int sizes[] = { 0, 4, 0 };
+  int keyAttrs[] = { 0, 1 };
+  char *strs[] = { "ab", "b", "ba", "c" };
+  int numA = 5, numB = 4;
+  int *permute;
+  int i, a, b, testint, rc;
+  Schema *schema;
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  Value *key[2], *lo, *hi;
+  DataType keyType;
+  RID rid;
+
+  testName = "composite keys with prefix and range scans";
+
+  schema = createSchema(3, names, dt, sizes, 2, keyAttrs);
+  permute = createPermutation(numA * numB);
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createCompositeBtree("testidx", 3, schema));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+  TEST_CHECK(getKeyType(tree, &keyType));
+  ASSERT_EQUALS_INT(DT_INT, keyType, "key type is the first key column");
+
+  // key (a, b) with a in -2..2, slot encodes the position in key order
+  for(i = 0; i < numA * numB; i++)
+    {
+      a = permute[i] / numB;
+      b = permute[i] % numB;
+      MAKE_VALUE(key[0], DT_INT, a - 2);
+      MAKE_STRING_VALUE(key[1], strs[b]);
+      rid.page = a;
+      rid.slot = permute[i];
+      TEST_CHECK(insertCompositeKey(tree, key, rid));
+      freeVal(key[0]);
+      freeVal(key[1]);
+    }
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(numA * numB, testint, "number of entries in btree");
+
+  MAKE_VALUE(key[0], DT_INT, -1);
+  MAKE_STRING_VALUE(key[1], "ba");
+  TEST_CHECK(findCompositeKey(tree, key, &rid));
+  ASSERT_EQUALS_INT(1 * numB + 2, rid.slot, "did we find the correct RID?");
+  freeVal(key[1]);
+  MAKE_STRING_VALUE(key[1], "bb");
+  ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findCompositeKey(tree, key, &rid),
+      "missing key not found");
+  freeVal(key[1]);
+
+  // a full scan orders negative ints first and strings bytewise
+  openTreeScan(tree, &sc);
+  i = 0;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    {
+      ASSERT_TRUE(rid.slot == i, "scan returns entries in key order");
+      i++;
+    }
+  ASSERT_EQUALS_INT(numA * numB, i, "have seen all entries");
+  closeTreeScan(sc);
+
+  // prefix on the leading column
+  TEST_CHECK(openPrefixScan(tree, key, 1, &sc));
+  i = 0;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    {
+      ASSERT_TRUE(rid.slot == 1 * numB + i, "prefix scan in key order");
+      i++;
+    }
+  ASSERT_EQUALS_INT(RC_IM_NO_MORE_ENTRIES, rc, "no error returned by scan");
+  ASSERT_EQUALS_INT(numB, i, "prefix scan sees every b for a = -1");
+  closeTreeScan(sc);
+  freeVal(key[0]);
+
+  // range over the leading column, both ends included
+  MAKE_VALUE(lo, DT_INT, 0);
+  MAKE_VALUE(hi, DT_INT, 5);
+  TEST_CHECK(openRangeScan(tree, &lo, &hi, 1, &sc));
+  i = 0;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    {
+      ASSERT_TRUE(rid.slot == 2 * numB + i, "range scan in key order");
+      i++;
+    }
+  ASSERT_EQUALS_INT(3 * numB, i, "range scan sees a = 0..2");
+  closeTreeScan(sc);
+  freeVal(lo);
+  freeVal(hi);
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+  free(permute);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testLongStringKeys (void)
+{
+  // the two long keys only differ past the 32 byte key column
+  char *prefix = "abcdefghijklmnopqrstuvwxyz012345";
+  char *longA = "abcdefghijklmnopqrstuvwxyz012345-first";
+  char *longB = "abcdefghijklmnopqrstuvwxyz012345-second";
+  int testint;
+  BTreeHandle *tree = NULL;
+  Value *key;
+  RID rid;
+
+  testName = "string keys longer than the key column";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_STRING, 2));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // a key filling the whole column is kept
+  MAKE_STRING_VALUE(key, prefix);
+  rid.page = 1;
+  rid.slot = 1;
+  TEST_CHECK(insertKey(tree, key, rid));
+  freeVal(key);
+
+  // longer keys are refused instead of being cut to the shared prefix
+  MAKE_STRING_VALUE(key, longA);
+  rid.page = 2;
+  ASSERT_EQUALS_INT(RC_IM_N_TO_LAGE, insertKey(tree, key, rid),
+      "first long key is refused");
+  ASSERT_EQUALS_INT(RC_IM_N_TO_LAGE, findKey(tree, key, &rid),
+      "long key does not find the prefix");
+  ASSERT_EQUALS_INT(RC_IM_N_TO_LAGE, deleteKey(tree, key),
+      "long key does not delete the prefix");
+  freeVal(key);
+  MAKE_STRING_VALUE(key, longB);
+  rid.page = 3;
+  ASSERT_EQUALS_INT(RC_IM_N_TO_LAGE, insertKey(tree, key, rid),
+      "second long key is refused");
+  freeVal(key);
+
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(1, testint, "number of entries in btree");
+  MAKE_STRING_VALUE(key, prefix);
+  TEST_CHECK(findKey(tree, key, &rid));
+  ASSERT_TRUE(rid.page == 1 && rid.slot == 1, "did we find the correct RID?");
+  freeVal(key);
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testTableIndexes (void)
+{
+  int numRows = 30, numValues = 5;
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+  int sizes[] = { 0, 4, 0 };
+  int keyAttrs[] = { 0 };
+  int expected[5] = { 0 };
+  RID rids[30];
+  int i, v, count, rc;
+  Schema *schema;
+  Record *record;
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  Value *value, *key[3];
+  RID rid;
+
+  testName = "record manager keeps secondary indexes up to date";
+
+  schema = createSchema(3, names, dt, sizes, 1, keyAttrs);
+  TEST_CHECK(createRecord(&record, schema));
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(createTable("test_table_idx", schema));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+
+  // b always fills its whole column, so its keys have no terminator
+  TEST_CHECK(createIndex(table, "test_idx_b", 1));
+
+  // rows present before the index is created are loaded into it
+  for(i = 0; i < numRows; i++)
+    {
+      if (i == numRows / 2)
+        TEST_CHECK(createIndex(table, "test_idx_c", 2));
+      MAKE_VALUE(value, DT_INT, i);
+      TEST_CHECK(setAttr(record, schema, 0, value));
+      freeVal(value);
+      MAKE_STRING_VALUE(value, "abcd");
+      TEST_CHECK(setAttr(record, schema, 1, value));
+      freeVal(value);
+      MAKE_VALUE(value, DT_INT, i % numValues);
+      TEST_CHECK(setAttr(record, schema, 2, value));
+      freeVal(value);
+      TEST_CHECK(insertRecord(table, record));
+      rids[i] = record->id;
+      expected[i % numValues]++;
+    }
+  TEST_CHECK(closeTable(table));
+
+  // openTable finds the index again
+  TEST_CHECK(openTable(table, "test_table_idx"));
+  for(i = 0; i < numRows; i += 3)
+    {
+      TEST_CHECK(getRecord(table, rids[i], record));
+      MAKE_VALUE(value, DT_INT, (i + 1) % numValues);
+      TEST_CHECK(setAttr(record, schema, 2, value));
+      freeVal(value);
+      TEST_CHECK(updateRecord(table, record));
+      expected[i % numValues]--;
+      expected[(i + 1) % numValues]++;
+    }
+  for(i = 1; i < numRows; i += 3)
+    {
+      TEST_CHECK(deleteRecord(table, rids[i]));
+      expected[i % numValues]--;
+    }
+
+  TEST_CHECK(getIndex(table, "test_idx_c", &tree));
+  TEST_CHECK(getNumEntries(tree, &count));
+  ASSERT_EQUALS_INT(numRows - numRows / 3, count, "one index entry per row");
+  for(v = 0; v < numValues; v++)
+    {
+      MAKE_VALUE(value, DT_INT, v);
+      TEST_CHECK(openPrefixScan(tree, &value, 1, &sc));
+      count = 0;
+      while((rc = nextEntry(sc, &rid)) == RC_OK)
+        count++;
+      ASSERT_EQUALS_INT(RC_IM_NO_MORE_ENTRIES, rc, "no error returned by scan");
+      ASSERT_EQUALS_INT(expected[v], count, "index entries for value");
+      closeTreeScan(sc);
+      freeVal(value);
+    }
+
+  // index errors reach the caller and leave the row as it was: take
+  // the entry of a row out behind the record manager's back
+  TEST_CHECK(getRecord(table, rids[0], record));
+  TEST_CHECK(getAttr(record, schema, 2, &key[0]));
+  MAKE_VALUE(key[1], DT_INT, rids[0].page);
+  MAKE_VALUE(key[2], DT_INT, rids[0].slot);
+  TEST_CHECK(deleteCompositeKey(tree, key));
+  ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, deleteRecord(table, rids[0]),
+      "deleting a row without index entry fails");
+  TEST_CHECK(getRecord(table, rids[0], record));
+  MAKE_VALUE(value, DT_INT, (key[0]->v.intV + 1) % numValues);
+  TEST_CHECK(setAttr(record, schema, 2, value));
+  freeVal(value);
+  ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, updateRecord(table, record),
+      "updating a row without index entry fails");
+  TEST_CHECK(getRecord(table, rids[0], record));
+  TEST_CHECK(getAttr(record, schema, 2, &value));
+  ASSERT_EQUALS_INT(key[0]->v.intV, value->v.intV, "row keeps its old value");
+  freeVal(value);
+  TEST_CHECK(getNumEntries(tree, &count));
+  ASSERT_EQUALS_INT(numRows - numRows / 3 - 1, count, "other entries untouched");
+  for(i = 0; i < 3; i++)
+    freeVal(key[i]);
+
+  // full width strings are indexed, also after the rebuild in openTable
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+  TEST_CHECK(getIndex(table, "test_idx_b", &tree));
+  MAKE_STRING_VALUE(value, "abcd");
+  TEST_CHECK(openPrefixScan(tree, &value, 1, &sc));
+  count = 0;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    count++;
+  ASSERT_EQUALS_INT(RC_IM_NO_MORE_ENTRIES, rc, "no error returned by scan");
+  ASSERT_EQUALS_INT(numRows - numRows / 3, count, "full width strings indexed");
+  closeTreeScan(sc);
+  freeVal(value);
+  TEST_CHECK(closeTable(table));
+
+  TEST_CHECK(deleteBtree("test_idx_b"));
+  TEST_CHECK(deleteBtree("test_idx_c"));
+  TEST_CHECK(deleteTable("test_table_idx"));
+  TEST_CHECK(shutdownRecordManager());
+  freeRecord(record);
+  free(table);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static int
+countScan (RM_TableData *table, Schema *schema, Expr *cond, int *lastPage)
+{
+  RM_ScanHandle sc;
+  Record *record;
+  int count = 0, rc;
+
+  TEST_CHECK(createRecord(&record, schema));
+  *lastPage = 0;
+  TEST_CHECK(startScan(table, &sc, cond));
+  while((rc = next(&sc, record)) == RC_OK)
+    {
+      ASSERT_TRUE(record->id.page >= *lastPage, "rows come in page order");
+      *lastPage = record->id.page;
+      count++;
+    }
+  ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "no error returned by scan");
+  TEST_CHECK(closeScan(&sc));
+  free(record->data);
+  freeRecord(record);
+  return count;
+}
+
+void
+testIndexedScan (void)
+{
+  int numRows = 1000;
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+  int sizes[] = { 0, 4, 0 };
+  int keyAttrs[] = { 0 };
+  int i, page;
+  Schema *schema;
+  Record *record;
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  Expr *attr, *cons, *cmp, *other, *cond;
+  Value *value;
+
+  testName = "startScan uses an index on the compared attribute";
+
+  schema = createSchema(3, names, dt, sizes, 1, keyAttrs);
+  TEST_CHECK(createRecord(&record, schema));
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(createTable("test_table_idx", schema));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+  TEST_CHECK(createIndex(table, "test_idx_c", 2));
+
+  // c is a descending value so index order and page order disagree
+  for(i = 0; i < numRows; i++)
+    {
+      MAKE_VALUE(value, DT_INT, i);
+      TEST_CHECK(setAttr(record, schema, 0, value));
+      freeVal(value);
+      MAKE_STRING_VALUE(value, "abcd");
+      TEST_CHECK(setAttr(record, schema, 1, value));
+      freeVal(value);
+      MAKE_VALUE(value, DT_INT, numRows - i);
+      TEST_CHECK(setAttr(record, schema, 2, value));
+      freeVal(value);
+      TEST_CHECK(insertRecord(table, record));
+    }
+
+  // c = 37
+  MAKE_ATTRREF(attr, 2);
+  MAKE_VALUE(value, DT_INT, 37);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cond, attr, cons, OP_COMP_EQUAL);
+  ASSERT_EQUALS_INT(1, countScan(table, schema, cond, &page), "equality through the index");
+  freeExpr(cond);
+
+  // c < 100
+  MAKE_ATTRREF(attr, 2);
+  MAKE_VALUE(value, DT_INT, 100);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cond, attr, cons, OP_COMP_SMALLER);
+  ASSERT_EQUALS_INT(99, countScan(table, schema, cond, &page), "upper bound through the index");
+  ASSERT_TRUE(page > 1, "rows span several pages");
+  freeExpr(cond);
+
+  // NOT (c < 290) AND a < 5
+  MAKE_ATTRREF(attr, 2);
+  MAKE_VALUE(value, DT_INT, 290);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cmp, attr, cons, OP_COMP_SMALLER);
+  MAKE_UNOP_EXPR(other, cmp, OP_BOOL_NOT);
+  MAKE_ATTRREF(attr, 0);
+  MAKE_VALUE(value, DT_INT, 5);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cmp, attr, cons, OP_COMP_SMALLER);
+  MAKE_BINOP_EXPR(cond, other, cmp, OP_BOOL_AND);
+  ASSERT_EQUALS_INT(5, countScan(table, schema, cond, &page), "lower bound and residual condition");
+  freeExpr(cond);
+
+  // deleted rows are not returned
+  record->id.page = 1;
+  record->id.slot = 0;
+  TEST_CHECK(deleteRecord(table, record->id));
+  MAKE_ATTRREF(attr, 2);
+  MAKE_VALUE(value, DT_INT, numRows);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cond, cons, attr, OP_COMP_EQUAL);
+  ASSERT_EQUALS_INT(0, countScan(table, schema, cond, &page), "deleted row is gone");
+  freeExpr(cond);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteBtree("test_idx_c"));
+  TEST_CHECK(deleteTable("test_table_idx"));
+  TEST_CHECK(shutdownRecordManager());
+  freeRecord(record);
+  free(table);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testParallelIndexBuild (void)
+{
+  int numRows = 3000, numValues = 100;
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+  int sizes[] = { 0, 4, 0 };
+  int keyAttrs[] = { 0 };
+  int i, count, page;
+  Schema *schema;
+  Record *record;
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  Expr *attr, *cons, *cond;
+  Value *value;
+  RID rid;
+
+  testName = "parallel index build over an existing table";
+
+  schema = createSchema(3, names, dt, sizes, 1, keyAttrs);
+  TEST_CHECK(createRecord(&record, schema));
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(createTable("test_table_idx", schema));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+
+  for(i = 0; i < numRows; i++)
+    {
+      MAKE_VALUE(value, DT_INT, i);
+      TEST_CHECK(setAttr(record, schema, 0, value));
+      freeVal(value);
+      MAKE_STRING_VALUE(value, "abcd");
+      TEST_CHECK(setAttr(record, schema, 1, value));
+      freeVal(value);
+      MAKE_VALUE(value, DT_INT, (i * 7) % numValues);
+      TEST_CHECK(setAttr(record, schema, 2, value));
+      freeVal(value);
+      TEST_CHECK(insertRecord(table, record));
+    }
+
+  TEST_CHECK(buildIndexOnTable(table, 2, "test_idx_c", 4));
+  TEST_CHECK(getIndex(table, "test_idx_c", &tree));
+  TEST_CHECK(getNumEntries(tree, &count));
+  ASSERT_EQUALS_INT(numRows, count, "one index entry per row");
+
+  // the merged runs come out in key order: value, then page and slot
+  TEST_CHECK(openTreeScan(tree, &sc));
+  count = 0;
+  while(nextEntry(sc, &rid) == RC_OK)
+    {
+      TEST_CHECK(getRecord(table, rid, record));
+      getAttr(record, schema, 2, &value);
+      ASSERT_TRUE(value->v.intV >= count / (numRows / numValues)
+          && value->v.intV <= count / (numRows / numValues), "entries sorted by value");
+      freeVal(value);
+      count++;
+    }
+  ASSERT_EQUALS_INT(numRows, count, "have seen all entries");
+  TEST_CHECK(closeTreeScan(sc));
+
+  // every b fills its whole column, the workers still index each row
+  TEST_CHECK(buildIndexOnTable(table, 1, "test_idx_b", 4));
+  TEST_CHECK(getIndex(table, "test_idx_b", &tree));
+  MAKE_STRING_VALUE(value, "abcd");
+  TEST_CHECK(openPrefixScan(tree, &value, 1, &sc));
+  count = 0;
+  while(nextEntry(sc, &rid) == RC_OK)
+    count++;
+  ASSERT_EQUALS_INT(numRows, count, "full width strings indexed");
+  TEST_CHECK(closeTreeScan(sc));
+  freeVal(value);
+
+  // the bulk built tree keeps taking inserts
+  MAKE_VALUE(value, DT_INT, 42);
+  TEST_CHECK(setAttr(record, schema, 2, value));
+  freeVal(value);
+  TEST_CHECK(insertRecord(table, record));
+  MAKE_ATTRREF(attr, 2);
+  MAKE_VALUE(value, DT_INT, 42);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cond, attr, cons, OP_COMP_EQUAL);
+  ASSERT_EQUALS_INT(numRows / numValues + 1, countScan(table, schema, cond, &page),
+      "equality through the built index");
+  freeExpr(cond);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteBtree("test_idx_b"));
+  TEST_CHECK(deleteBtree("test_idx_c"));
+  TEST_CHECK(deleteTable("test_table_idx"));
+  TEST_CHECK(shutdownRecordManager());
+  freeRecord(record);
+  free(table);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testSnapshot (void)
+{
+  int numInserts = 100;
+  int i, count, testint;
+  int *permute;
+  BTreeHandle *tree = NULL, *snap = NULL;
+  BT_ScanHandle *sc = NULL;
+  RID rid;
+  Value key;
+
+  testName = "snapshot keeps the tree as it was";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_INT, 2));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // even keys go in before the snapshot
+  permute = createPermutation(numInserts);
+  key.dt = DT_INT;
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = 2 * permute[i];
+      rid.page = key.v.intV;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+  TEST_CHECK(snapshotBtree(tree, &snap));
+
+  // splits, deletes and replaced RIDs in the live tree
+  TEST_CHECK(openTreeScan(snap, &sc));
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = 2 * i + 1;
+      rid.page = key.v.intV;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+      if (i % 3 == 0)
+        {
+          key.v.intV = 2 * i;
+          TEST_CHECK(deleteKey(tree, &key));
+        }
+      else if (i % 3 == 1)
+        {
+          key.v.intV = 2 * i;
+          rid.page = -1;
+          TEST_CHECK(upsertKey(tree, &key, rid, NULL, NULL));
+        }
+    }
+
+  // a scan opened before the changes sees none of them
+  count = 0;
+  while(nextEntry(sc, &rid) == RC_OK)
+    {
+      ASSERT_TRUE(rid.page == 2 * count, "snapshot entries in order");
+      count++;
+    }
+  ASSERT_EQUALS_INT(numInserts, count, "have seen all snapshot entries");
+  TEST_CHECK(closeTreeScan(sc));
+  TEST_CHECK(getNumEntries(snap, &testint));
+  ASSERT_EQUALS_INT(numInserts, testint, "number of entries in snapshot");
+
+  key.v.intV = 0;
+  TEST_CHECK(findKey(snap, &key, &rid));
+  ASSERT_TRUE(rid.page == 0, "deleted key is still in the snapshot");
+  key.v.intV = 1;
+  ASSERT_TRUE(findKey(snap, &key, &rid) == RC_IM_KEY_NOT_FOUND, "new key is not in the snapshot");
+  ASSERT_TRUE(insertKey(snap, &key, rid) == RC_IM_READ_ONLY, "snapshot is read only");
+  TEST_CHECK(closeSnapshot(snap));
+
+  // the live tree has all changes
+  TEST_CHECK(openTreeScan(tree, &sc));
+  count = 0;
+  while(nextEntry(sc, &rid) == RC_OK)
+    count++;
+  TEST_CHECK(closeTreeScan(sc));
+  ASSERT_EQUALS_INT(2 * numInserts - (numInserts + 2) / 3, count, "have seen all live entries");
+  key.v.intV = 2;
+  TEST_CHECK(findKey(tree, &key, &rid));
+  ASSERT_TRUE(rid.page == -1, "upserted RID in the live tree");
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+  free(permute);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testPageRefs (void)
+{
+  int numPages = 6;
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageRef refs[numPages];
+  SM_FileHandle fh;
+
+  testName = "swizzled page references";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(numPages, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+  // the first pin swizzles the reference, later pins go straight to the frame
+  for(i = 0; i < 3; i++)
+    {
+      refs[i] = MAKE_PAGE_REF(i);
+      ASSERT_TRUE(!IS_SWIZZLED(refs[i]), "new reference holds the page number");
+      TEST_CHECK(pinPageRef(bm, h, &refs[i]));
+      ASSERT_TRUE(IS_SWIZZLED(refs[i]), "resident page is swizzled");
+      ASSERT_EQUALS_INT(i, h->pageNum, "pinned the referenced page");
+      sprintf(h->data, "Page-%i", i);
+      TEST_CHECK(markDirty(bm, h));
+      TEST_CHECK(unpinPage(bm, h));
+      TEST_CHECK(pinPageRef(bm, h, &refs[i]));
+      ASSERT_EQUALS_INT(i, getPageRefNum(refs[i]), "swizzled reference knows its page");
+      TEST_CHECK(unpinPage(bm, h));
+    }
+
+  // evicting the frames turns the references back into page numbers
+  for(i = 3; i < numPages; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  for(i = 0; i < 3; i++)
+    {
+      ASSERT_TRUE(!IS_SWIZZLED(refs[i]), "evicted page is unswizzled");
+      ASSERT_EQUALS_INT(i, getPageRefNum(refs[i]), "reference keeps its page");
+    }
+  TEST_CHECK(pinPageRef(bm, h, &refs[1]));
+  ASSERT_EQUALS_STRING("Page-1", h->data, "page was written back on eviction");
+  TEST_CHECK(unpinPage(bm, h));
+  TEST_CHECK(unswizzlePageRef(bm, &refs[1]));
+  ASSERT_TRUE(!IS_SWIZZLED(refs[1]), "released reference holds the page number");
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testScanPosition (void)
+{
+  int numInserts = 100;
+  int i, count, last;
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  BT_ScanPosition *pos = NULL;
+  RID rid;
+  Value key;
+
+  testName = "saved scan positions survive changes";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtree("testidx", DT_INT, 3));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // even keys, the RID page is the key
+  key.dt = DT_INT;
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = 2 * i;
+      rid.page = key.v.intV;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+
+  // first page of results, then pick up where it ended
+  TEST_CHECK(openTreeScan(tree, &sc));
+  for(i = 0; i < 10; i++)
+    TEST_CHECK(nextEntry(sc, &rid));
+  TEST_CHECK(saveScanPosition(sc, &pos));
+  TEST_CHECK(closeTreeScan(sc));
+  TEST_CHECK(restoreScanPosition(tree, pos, &sc));
+  TEST_CHECK(nextEntry(sc, &rid));
+  ASSERT_EQUALS_INT(20, rid.page, "restored scan continues after the last key");
+  TEST_CHECK(closeTreeScan(sc));
+
+  // split every leaf and delete the next key before restoring again
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = 2 * i + 1;
+      rid.page = key.v.intV;
+      rid.slot = 0;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+  key.v.intV = 20;
+  TEST_CHECK(deleteKey(tree, &key));
+  TEST_CHECK(restoreScanPosition(tree, pos, &sc));
+  TEST_CHECK(freeScanPosition(pos));
+  count = 0;
+  last = 18;
+  while(nextEntry(sc, &rid) == RC_OK)
+    {
+      ASSERT_TRUE(rid.page > last, "entries after the saved key in order");
+      last = rid.page;
+      count++;
+    }
+  ASSERT_EQUALS_INT(2 * numInserts - 19 - 1, count, "have seen all later entries");
+  TEST_CHECK(closeTreeScan(sc));
+
+  // an open scan keeps its place while leaves are split under it
+  TEST_CHECK(openTreeScan(tree, &sc));
+  for(i = 0; i < 5; i++)
+    TEST_CHECK(nextEntry(sc, &rid));
+  last = rid.page;
+  for(i = 0; i < numInserts; i++)
+    {
+      key.v.intV = -1 - i;
+      rid.page = key.v.intV;
+      TEST_CHECK(insertKey(tree, &key, rid));
+      key.v.intV = 1000 + i;
+      rid.page = key.v.intV;
+      TEST_CHECK(insertKey(tree, &key, rid));
+    }
+  count = 0;
+  while(nextEntry(sc, &rid) == RC_OK)
+    {
+      ASSERT_TRUE(rid.page > last, "no entry is repeated");
+      last = rid.page;
+      count++;
+    }
+  ASSERT_EQUALS_INT(2 * numInserts - 5 - 1 + numInserts, count, "no entry is skipped");
+  TEST_CHECK(closeTreeScan(sc));
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static Expr *
+equalsInt (int attrNum, int c)
+{
+  Expr *attr, *cons, *cond;
+  Value *value;
+
+  MAKE_ATTRREF(attr, attrNum);
+  MAKE_VALUE(value, DT_INT, c);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cond, attr, cons, OP_COMP_EQUAL);
+  return cond;
+}
+
+void
+testBitmapIndex (void)
+{
+  int numRows = 600;
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_BOOL, DT_INT };
+  int sizes[] = { 0, 0, 0 };
+  int keyAttrs[] = { 0 };
+  int i, count, page;
+  Schema *schema;
+  Record *record;
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  BitmapHandle *index = NULL, *other = NULL;
+  Bitmap *rows;
+  Expr *attr, *cons, *left, *right, *cond;
+  Value *value;
+  RID *rids = (RID *) malloc(numRows * sizeof(RID));
+
+  testName = "bitmap indexes answer AND, OR and NOT of equalities";
+
+  schema = createSchema(3, names, dt, sizes, 1, keyAttrs);
+  TEST_CHECK(createRecord(&record, schema));
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(createTable("test_table_idx", schema));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+
+  // half the rows are there before the indexes, half come after
+  for(i = 0; i < numRows; i++)
+    {
+      if(i == numRows / 2)
+        {
+          TEST_CHECK(createBitmapIndexOnTable(table, 2, "test_bmp_c"));
+          TEST_CHECK(createBitmapIndexOnTable(table, 1, "test_bmp_b"));
+        }
+      MAKE_VALUE(value, DT_INT, i);
+      TEST_CHECK(setAttr(record, schema, 0, value));
+      freeVal(value);
+      MAKE_VALUE(value, DT_BOOL, i % 2 == 0);
+      TEST_CHECK(setAttr(record, schema, 1, value));
+      freeVal(value);
+      MAKE_VALUE(value, DT_INT, i % 4);
+      TEST_CHECK(setAttr(record, schema, 2, value));
+      freeVal(value);
+      TEST_CHECK(insertRecord(table, record));
+      rids[i] = record->id;
+    }
+  TEST_CHECK(getBitmapIndex(table, "test_bmp_c", &index));
+  TEST_CHECK(getNumValues(index, &count));
+  ASSERT_EQUALS_INT(4, count, "one bitmap per value");
+
+  // b = true AND c = 2
+  MAKE_ATTRREF(attr, 1);
+  MAKE_VALUE(value, DT_BOOL, 1);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(left, attr, cons, OP_COMP_EQUAL);
+  MAKE_BINOP_EXPR(cond, left, equalsInt(2, 2), OP_BOOL_AND);
+  ASSERT_EQUALS_INT(numRows / 4, countScan(table, schema, cond, &page), "AND of two bitmaps");
+  freeExpr(cond);
+
+  // c = 1 OR c = 3
+  MAKE_BINOP_EXPR(cond, equalsInt(2, 1), equalsInt(2, 3), OP_BOOL_OR);
+  ASSERT_EQUALS_INT(numRows / 2, countScan(table, schema, cond, &page), "OR of two bitmaps");
+  ASSERT_TRUE(page > 1, "rows span several pages");
+  freeExpr(cond);
+
+  // NOT (c = 1)
+  MAKE_UNOP_EXPR(cond, equalsInt(2, 1), OP_BOOL_NOT);
+  ASSERT_EQUALS_INT(numRows - numRows / 4, countScan(table, schema, cond, &page), "NOT of a bitmap");
+  freeExpr(cond);
+
+  // c = 2 AND a < 10, the bitmap narrows and the rest is evaluated per row
+  MAKE_ATTRREF(attr, 0);
+  MAKE_VALUE(value, DT_INT, 10);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(right, attr, cons, OP_COMP_SMALLER);
+  MAKE_BINOP_EXPR(cond, equalsInt(2, 2), right, OP_BOOL_AND);
+  ASSERT_EQUALS_INT(2, countScan(table, schema, cond, &page), "bitmap and residual condition");
+  freeExpr(cond);
+
+  // deletes and updates keep the bitmaps current
+  for(i = 0; i < 100; i++)
+    TEST_CHECK(deleteRecord(table, rids[i]));
+  TEST_CHECK(getRecord(table, rids[100], record));
+  MAKE_VALUE(value, DT_INT, 1);
+  TEST_CHECK(setAttr(record, schema, 2, value));
+  TEST_CHECK(updateRecord(table, record));
+  TEST_CHECK(getValueBitmap(index, value, &rows));
+  ASSERT_EQUALS_INT(numRows / 4 - 25 + 1, bitmapCount(rows), "bits of deleted and updated rows");
+  TEST_CHECK(freeBitmap(rows));
+
+  // a flush puts the changes in the page file while the table is open
+  TEST_CHECK(flushBitmapIndex(index));
+  TEST_CHECK(openBitmapIndex(&other, "test_bmp_c"));
+  TEST_CHECK(getValueBitmap(other, value, &rows));
+  ASSERT_EQUALS_INT(numRows / 4 - 25 + 1, bitmapCount(rows), "flushed bits read back");
+  TEST_CHECK(freeBitmap(rows));
+  TEST_CHECK(closeBitmapIndex(other));
+  freeVal(value);
+
+  // an index file without its header page is refused
+  fclose(fopen("test_bmp_empty", "w"));
+  ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, openBitmapIndex(&other, "test_bmp_empty"),
+      "empty index file");
+  TEST_CHECK(deleteBitmapIndex("test_bmp_empty"));
+
+  // the bitmaps are kept compressed in their page file across a reopen
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+  cond = equalsInt(2, 1);
+  ASSERT_EQUALS_INT(numRows / 4 - 25 + 1, countScan(table, schema, cond, &page), "bitmap read back");
+  freeExpr(cond);
+  MAKE_UNOP_EXPR(cond, equalsInt(2, 1), OP_BOOL_NOT);
+  ASSERT_EQUALS_INT(numRows - 100 - (numRows / 4 - 25 + 1), countScan(table, schema, cond, &page),
+      "NOT skips deleted rows");
+  freeExpr(cond);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteBitmapIndex("test_bmp_c"));
+  TEST_CHECK(deleteBitmapIndex("test_bmp_b"));
+  TEST_CHECK(deleteTable("test_table_idx"));
+  TEST_CHECK(shutdownRecordManager());
+  freeRecord(record);
+  free(rids);
+  free(table);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static Expr *
+smallerInt (int attrNum, int c)
+{
+  Expr *attr, *cons, *cond;
+  Value *value;
+
+  MAKE_ATTRREF(attr, attrNum);
+  MAKE_VALUE(value, DT_INT, c);
+  MAKE_CONS(cons, value);
+  MAKE_BINOP_EXPR(cond, attr, cons, OP_COMP_SMALLER);
+  return cond;
+}
+
+void
+testIndexMerge (void)
+{
+  int numRows = 1000;
+  char *names[] = { "a", "b", "c" };
+  DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+  int sizes[] = { 0, 4, 0 };
+  int keyAttrs[] = { 0 };
+  int i, page;
+  Schema *schema;
+  Record *record;
+  RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+  Expr *cond, *either, *negated;
+  Value *value;
+
+  testName = "index merge intersects and unions RID lists of several indexes";
+
+  schema = createSchema(3, names, dt, sizes, 1, keyAttrs);
+  TEST_CHECK(createRecord(&record, schema));
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(createTable("test_table_idx", schema));
+  TEST_CHECK(openTable(table, "test_table_idx"));
+  TEST_CHECK(createIndex(table, "test_idx_a", 0));
+  TEST_CHECK(createIndex(table, "test_idx_c", 2));
+
+  for(i = 0; i < numRows; i++)
+    {
+      MAKE_VALUE(value, DT_INT, numRows - i);
+      TEST_CHECK(setAttr(record, schema, 0, value));
+      freeVal(value);
+      MAKE_STRING_VALUE(value, "abcd");
+      TEST_CHECK(setAttr(record, schema, 1, value));
+      freeVal(value);
+      MAKE_VALUE(value, DT_INT, i % 10);
+      TEST_CHECK(setAttr(record, schema, 2, value));
+      freeVal(value);
+      TEST_CHECK(insertRecord(table, record));
+    }
+
+  // a < 101 AND c = 3
+  MAKE_BINOP_EXPR(cond, smallerInt(0, 101), equalsInt(2, 3), OP_BOOL_AND);
+  ASSERT_EQUALS_INT(10, countScan(table, schema, cond, &page), "intersection of two indexes");
+  freeExpr(cond);
+
+  // a < 11 OR c = 3, a = 7 has c = 3 and comes back once
+  MAKE_BINOP_EXPR(cond, smallerInt(0, 11), equalsInt(2, 3), OP_BOOL_OR);
+  ASSERT_EQUALS_INT(10 + numRows / 10 - 1, countScan(table, schema, cond, &page), "union of two indexes");
+  ASSERT_TRUE(page > 1, "rows span several pages");
+  freeExpr(cond);
+
+  // (c = 1 OR c = 2) AND NOT (a < 991)
+  MAKE_BINOP_EXPR(either, equalsInt(2, 1), equalsInt(2, 2), OP_BOOL_OR);
+  MAKE_UNOP_EXPR(negated, smallerInt(0, 991), OP_BOOL_NOT);
+  MAKE_BINOP_EXPR(cond, either, negated, OP_BOOL_AND);
+  ASSERT_EQUALS_INT(2, countScan(table, schema, cond, &page), "nested union and intersection");
+  freeExpr(cond);
+
+  // c = 3 AND c = 4 has no rows
+  MAKE_BINOP_EXPR(cond, equalsInt(2, 3), equalsInt(2, 4), OP_BOOL_AND);
+  ASSERT_EQUALS_INT(0, countScan(table, schema, cond, &page), "empty intersection");
+  freeExpr(cond);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteBtree("test_idx_a"));
+  TEST_CHECK(deleteBtree("test_idx_c"));
+  TEST_CHECK(deleteTable("test_table_idx"));
+  TEST_CHECK(shutdownRecordManager());
+  freeRecord(record);
+  free(table);
+  free(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testFrameTable (void)
+{
+  int numFrames = 2048, numPages = 3000;
+  int i, j, reads, evicted = NO_PAGE;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  PageNumber *frames;
+  SM_FileHandle fh;
+  char expected[16];
+
+  testName = "frame table finds pages in large pools";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(numPages, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_FIFO, NULL));
+
+  for(i = 0; i < numFrames; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "Page-%i", i);
+      TEST_CHECK(markDirty(bm, h));
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(numFrames, getNumReadIO(bm), "one read per page");
+
+  // every page is found again without a read
+  for(i = numFrames - 1; i >= 0; i--)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      sprintf(expected, "Page-%i", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "found the frame of the page");
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(numFrames, getNumReadIO(bm), "pins of resident pages are hits");
+
+  // replacing pages keeps the table in step with the frames
+  for(i = numFrames; i < numPages; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "Page-%i", i);
+      TEST_CHECK(markDirty(bm, h));
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  reads = getNumReadIO(bm);
+  frames = getFrameContents(bm);
+  for(i = 0; i < numFrames; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, frames[i]));
+      ASSERT_EQUALS_INT(frames[i], h->pageNum, "pinned the resident page");
+      sprintf(expected, "Page-%i", frames[i]);
+      ASSERT_EQUALS_STRING(expected, h->data, "resident page has its own frame");
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "no reads for resident pages");
+  for(i = 0; i < numPages && evicted == NO_PAGE; i++)
+    {
+      for(j = 0; j < numFrames && frames[j] != i; j++);
+      if(j == numFrames)
+        evicted = i;
+    }
+  free(frames);
+  TEST_CHECK(pinPage(bm, h, evicted));
+  sprintf(expected, "Page-%i", evicted);
+  ASSERT_EQUALS_STRING(expected, h->data, "evicted page was written back");
+  TEST_CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(reads + 1, getNumReadIO(bm), "evicted page is read again");
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testFrameArena (void)
+{
+  int numFrames = 4, numPages = 20;
+  int i, j;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char *frames[numFrames];
+  SM_FileHandle fh;
+
+  testName = "frames reuse one preallocated arena";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(numPages, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_LRU, NULL));
+
+  for(i = 0; i < numFrames; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      frames[i] = h->data;
+      ASSERT_TRUE(((uintptr_t) h->data) % PAGE_SIZE == 0, "frame is page aligned");
+      TEST_CHECK(unpinPage(bm, h));
+    }
+
+  // replaced pages land in the same memory
+  for(i = numFrames; i < numPages; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      for(j = 0; j < numFrames && frames[j] != h->data; j++);
+      ASSERT_TRUE(j < numFrames, "page reuses a frame of the arena");
+      sprintf(h->data, "Page-%i", i);
+      TEST_CHECK(markDirty(bm, h));
+      TEST_CHECK(unpinPage(bm, h));
+    }
+
+  // a page past the end of the file starts out zeroed
+  TEST_CHECK(pinPage(bm, h, numPages + 5));
+  for(i = 0; i < PAGE_SIZE && h->data[i] == 0; i++);
+  ASSERT_EQUALS_INT(PAGE_SIZE, i, "new page is zeroed");
+  TEST_CHECK(unpinPage(bm, h));
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static void
+pinAndUnpin (BM_BufferPool *bm, BM_PageHandle *h, int pageNum)
+{
+  TEST_CHECK(pinPage(bm, h, pageNum));
+  TEST_CHECK(unpinPage(bm, h));
+}
+
+static void
+assertFrames (BM_BufferPool *bm, char *expected, char *message)
+{
+  char *contents = sprintPoolContent(bm);
+  ASSERT_EQUALS_STRING(expected, contents, message);
+  free(contents);
+}
+
+void
+testClock (void)
+{
+  int numPages = 10;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  char *contents;
+
+  testName = "CLOCK replacement gives used frames a second chance";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(numPages, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+
+  pinAndUnpin(bm, h, 0);
+  pinAndUnpin(bm, h, 1);
+  pinAndUnpin(bm, h, 2);
+  assertFrames(bm, "[0 0],[1 0],[2 0]", "frames fill in order");
+
+  // every bit is set: one round clears them, the hand stops at frame 0
+  pinAndUnpin(bm, h, 3);
+  assertFrames(bm, "[3 0],[1 0],[2 0]", "replaced the first frame after a round");
+
+  // page 1 is used again and gets a second chance, page 2 goes
+  pinAndUnpin(bm, h, 1);
+  pinAndUnpin(bm, h, 4);
+  assertFrames(bm, "[3 0],[1 0],[4 0]", "used page survives the hand");
+
+  // pinned frames are passed over
+  TEST_CHECK(pinPage(bm, pinned, 1));
+  pinAndUnpin(bm, h, 5);
+  pinAndUnpin(bm, h, 6);
+  pinAndUnpin(bm, h, 7);
+  contents = sprintPoolContent(bm);
+  ASSERT_TRUE(strstr(contents, "[1 1]") != NULL, "pinned page stays");
+  free(contents);
+  TEST_CHECK(unpinPage(bm, pinned));
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  free(pinned);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+// hot pages 0 and 1 are used over and over, then a scan goes once
+// through scanLength other pages, pinning each a few times in a row
+// like a record scan does. Returns the reads needed to use the hot
+// pages again.
+static int
+scanPollution (ReplacementStrategy strategy, void *stratData, int scanLength)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  int i, j, reads;
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(scanLength + 2, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, strategy, stratData));
+
+  for(i = 0; i < 20; i++)
+    {
+      pinAndUnpin(bm, h, 0);
+      pinAndUnpin(bm, h, 1);
+    }
+  for(i = 2; i < scanLength + 2; i++)
+    for(j = 0; j < 3; j++)
+      pinAndUnpin(bm, h, i);
+
+  reads = getNumReadIO(bm);
+  pinAndUnpin(bm, h, 0);
+  pinAndUnpin(bm, h, 1);
+  reads = getNumReadIO(bm) - reads;
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  return reads;
+}
+
+void
+testLfuLruK (void)
+{
+  int k = 2;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+
+  testName = "LFU and LRU-K keep hot pages through scans";
+
+  ASSERT_EQUALS_INT(2, scanPollution(RS_LRU, NULL, 20), "LRU loses the hot pages to a scan");
+  ASSERT_EQUALS_INT(0, scanPollution(RS_LFU, NULL, 20), "LFU keeps the hot pages");
+  ASSERT_EQUALS_INT(2, scanPollution(RS_LFU, NULL, 200), "LFU ages out pages hot long ago");
+  ASSERT_EQUALS_INT(0, scanPollution(RS_LRU_K, &k, 20), "LRU-2 keeps the hot pages");
+  ASSERT_EQUALS_INT(0, scanPollution(RS_LRU_K, &k, 200), "LRU-2 keeps them through long scans");
+  ASSERT_EQUALS_INT(0, scanPollution(RS_LRU_K, NULL, 200), "K defaults to two");
+
+  // pinned frames are never evicted, a full pool of them is an error
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(4, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU_K, &k));
+  TEST_CHECK(pinPage(bm, pinned, 0));
+  pinAndUnpin(bm, h, 1);
+  pinAndUnpin(bm, h, 2);
+  pinAndUnpin(bm, h, 3);
+  assertFrames(bm, "[0 1],[3 0]", "pinned page stays");
+  TEST_CHECK(pinPage(bm, h, 3));
+  ASSERT_TRUE(pinPage(bm, h, 2) == RC_NO_UNPINNED_PAGES_IN_BUFFER_POOL, "no frame to evict");
+  TEST_CHECK(unpinPage(bm, h));
+  TEST_CHECK(unpinPage(bm, pinned));
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  free(pinned);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+// replays a trace of page numbers, pinning and unpinning each page, 
+// and returns the percentage of pins that found their page resident
+static int
+traceHitRatio (ReplacementStrategy strategy, int numFrames, int *trace, int length)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  int i, maxPage = 0, misses;
+
+  for(i = 0; i < length; i++)
+    if(trace[i] > maxPage)
+      maxPage = trace[i];
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(maxPage + 1, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, strategy, NULL));
+
+  for(i = 0; i < length; i++)
+    pinAndUnpin(bm, h, trace[i]);
+  misses = getNumReadIO(bm);
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  return 100 * (length - misses) / length;
+}
+
+void
+testArc (void)
+{
+  int numFrames = 10, length = 0;
+  int trace[5000];
+  int round, i, j, fifo, lru, arc;
+
+  testName = "ARC keeps the working set through table scans";
+
+  // index lookups on 8 hot pages, with a report scanning 40 pages of a 
+  // table every so often, a record at a time
+  for(round = 0; round < 10; round++)
+    {
+      for(i = 0; i < 200; i++)
+        trace[length++] = (i * 5) % 8;
+      for(i = 0; i < 40; i++)
+        for(j = 0; j < 3; j++)
+          trace[length++] = 100 + i;
+    }
+
+  fifo = traceHitRatio(RS_FIFO, numFrames, trace, length);
+  lru = traceHitRatio(RS_LRU, numFrames, trace, length);
+  arc = traceHitRatio(RS_ARC, numFrames, trace, length);
+  printf("hit ratio: FIFO %i%%, LRU %i%%, ARC %i%%\n", fifo, lru, arc);
+  ASSERT_TRUE(arc > lru, "ARC beats LRU on scans");
+  ASSERT_TRUE(arc > fifo, "ARC beats FIFO on scans");
+
+  // without scans ARC does as well as LRU
+  length = 0;
+  for(i = 0; i < 2000; i++)
+    trace[length++] = (i * 7) % 9;
+  ASSERT_EQUALS_INT(traceHitRatio(RS_LRU, numFrames, trace, length),
+      traceHitRatio(RS_ARC, numFrames, trace, length), "ARC matches LRU on a working set that fits");
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testPoolFile (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  testName = "buffer pool keeps its page file open";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+  // a write back past the end grows the file, at once for other handles
+  TEST_CHECK(pinPage(bm, h, 4));
+  sprintf(h->data, "Page-4");
+  TEST_CHECK(markDirty(bm, h));
+  TEST_CHECK(forcePage(bm, h));
+  TEST_CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(0, getNumReadIO(bm), "page past the end is not read");
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "page written once");
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(5, fh.totalNumPages, "file grew to the page");
+  TEST_CHECK(readBlock(4, &fh, page));
+  ASSERT_EQUALS_STRING("Page-4", page, "write back reached the file");
+  TEST_CHECK(readBlock(2, &fh, page));
+  ASSERT_EQUALS_INT(0, page[0], "skipped pages read as zeros");
+
+  // pages appended through another handle are found by the pool
+  TEST_CHECK(ensureCapacity(7, &fh));
+  sprintf(page, "Page-6");
+  TEST_CHECK(writeBlock(6, &fh, page));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(pinPage(bm, h, 6));
+  ASSERT_EQUALS_STRING("Page-6", h->data, "pool reads the appended page");
+  ASSERT_EQUALS_INT(1, getNumReadIO(bm), "one read for the miss");
+  TEST_CHECK(unpinPage(bm, h));
+
+  TEST_CHECK(shutdownBufferPool(bm));
+  ASSERT_TRUE(initBufferPool(bm, "no_such_file.bin", 3, RS_FIFO, NULL) == RC_FILE_NOT_FOUND, "missing page file");
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  free(page);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testPoolStats (void)
+{
+  BM_BufferPool *first = MAKE_POOL();
+  BM_BufferPool *second = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  int i;
+
+  testName = "buffer pools keep their own statistics";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(10, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(createPageFile("testbuffer2.bin"));
+  TEST_CHECK(openPageFile("testbuffer2.bin", &fh));
+  TEST_CHECK(ensureCapacity(10, &fh));
+  TEST_CHECK(closePageFile(&fh));
+
+  TEST_CHECK(initBufferPool(first, "testbuffer.bin", 3, RS_FIFO, NULL));
+  for(i = 0; i < 5; i++)
+    {
+      TEST_CHECK(pinPage(first, h, i));
+      TEST_CHECK(markDirty(first, h));
+      TEST_CHECK(unpinPage(first, h));
+    }
+
+  // a second pool starts at zero and leaves the first one's counts alone
+  TEST_CHECK(initBufferPool(second, "testbuffer2.bin", 3, RS_LRU, NULL));
+  ASSERT_EQUALS_INT(0, getNumReadIO(second), "new pool has no reads");
+  ASSERT_EQUALS_INT(5, getNumReadIO(first), "reads of the first pool kept");
+  ASSERT_EQUALS_INT(2, getNumWriteIO(first), "writes of the first pool kept");
+  pinAndUnpin(second, h, 7);
+  pinAndUnpin(first, h, 4);
+  ASSERT_EQUALS_INT(1, getNumReadIO(second), "second pool counts its own reads");
+  ASSERT_EQUALS_INT(5, getNumReadIO(first), "hit in the first pool");
+  ASSERT_EQUALS_INT(0, getNumWriteIO(second), "second pool wrote nothing");
+
+  // both pools replace pages independently
+  for(i = 0; i < 10; i++)
+    {
+      pinAndUnpin(first, h, i);
+      pinAndUnpin(second, h, 9 - i);
+    }
+  ASSERT_EQUALS_INT(15, getNumReadIO(first), "first pool reads");
+  ASSERT_EQUALS_INT(10, getNumReadIO(second), "second pool reads");
+
+  TEST_CHECK(shutdownBufferPool(second));
+  TEST_CHECK(shutdownBufferPool(first));
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  TEST_CHECK(destroyPageFile("testbuffer2.bin"));
+  free(first);
+  free(second);
+  free(h);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+#define POOL_THREADS 8
+#define POOL_PAGES 40
+
+typedef struct PoolWorker {
+  BM_BufferPool *bm;
+  pthread_barrier_t *start;
+  unsigned int seed;
+  int ops;
+  int counts[POOL_PAGES];
+  RC rc;
+} PoolWorker;
+
+// every worker pins page 5 at the same time
+static void *
+pinSamePage (void *arg)
+{
+  PoolWorker *w = arg;
+  BM_PageHandle h;
+
+  pthread_barrier_wait(w->start);
+  w->rc = pinPage(w->bm, &h, 5);
+  if (w->rc == RC_OK)
+    w->rc = unpinPage(w->bm, &h);
+  return NULL;
+}
+
+// bumps a counter on random pages under an exclusive latch
+static void *
+bumpPages (void *arg)
+{
+  PoolWorker *w = arg;
+  BM_PageHandle h;
+  int i, pageNum;
+
+  pthread_barrier_wait(w->start);
+  for (i = 0; i < w->ops && w->rc == RC_OK; i++)
+    {
+      pageNum = rand_r(&w->seed) % POOL_PAGES;
+      if ((w->rc = pinPage(w->bm, &h, pageNum)) != RC_OK)
+        break;
+      latchPage(w->bm, &h, TRUE);
+      (*(int *) h.data)++;
+      w->rc = markDirty(w->bm, &h);
+      unlatchPage(w->bm, &h);
+      unpinPage(w->bm, &h);
+      w->counts[pageNum]++;
+    }
+  return NULL;
+}
+
+// half the workers flush the pool while the others bump pages
+static void *
+bumpOrFlush (void *arg)
+{
+  PoolWorker *w = arg;
+  int i;
+
+  if (w->seed % 2 == 1)
+    return bumpPages(arg);
+  pthread_barrier_wait(w->start);
+  // flushes are quick, they keep going for as long as the bumps
+  for (i = 0; i < 50 * w->ops && w->rc == RC_OK; i++)
+    w->rc = forceFlushPool(w->bm);
+  return NULL;
+}
+
+static void
+runPoolWorkers (BM_BufferPool *bm, PoolWorker *workers, void *(*work) (void *))
+{
+  pthread_t threads[POOL_THREADS];
+  pthread_barrier_t start;
+  int i;
+
+  pthread_barrier_init(&start, NULL, POOL_THREADS);
+  for (i = 0; i < POOL_THREADS; i++)
+    {
+      memset(&workers[i], 0, sizeof(PoolWorker));
+      workers[i].bm = bm;
+      workers[i].start = &start;
+      workers[i].seed = i + 1;
+      workers[i].ops = 2000;
+      pthread_create(&threads[i], NULL, work, &workers[i]);
+    }
+  for (i = 0; i < POOL_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  pthread_barrier_destroy(&start);
+}
+
+void
+testConcurrentPool (void)
+{
+  ReplacementStrategy strategies[] = { RS_FIFO, RS_CLOCK, RS_LRU_K, RS_ARC };
+  BM_BufferPool *bm = MAKE_POOL();
+  PoolWorker workers[POOL_THREADS];
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+  SM_FileHandle fh;
+  int s, i, j, expected;
+
+  testName = "concurrent pins share reads and lose no updates";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(POOL_PAGES, &fh));
+  TEST_CHECK(closePageFile(&fh));
+
+  // concurrent misses on one page read it once
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_FIFO, NULL));
+  runPoolWorkers(bm, workers, pinSamePage);
+  for (i = 0; i < POOL_THREADS; i++)
+    TEST_CHECK(workers[i].rc);
+  ASSERT_EQUALS_INT(1, getNumReadIO(bm), "one read for all the pins");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  // evictions write back while other threads miss on the same pages
+  for (s = 0; s < 4; s++)
+    {
+      TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 8, strategies[s], NULL));
+      runPoolWorkers(bm, workers, bumpPages);
+      for (i = 0; i < POOL_THREADS; i++)
+        TEST_CHECK(workers[i].rc);
+      TEST_CHECK(shutdownBufferPool(bm));
+
+      TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+      for (j = 0; j < POOL_PAGES; j++)
+        {
+          for (expected = 0, i = 0; i < POOL_THREADS; i++)
+            expected += workers[i].counts[j];
+          TEST_CHECK(readBlock(j, &fh, page));
+          ASSERT_EQUALS_INT(expected, *(int *) page, "page counts every update");
+          memset(page, 0, PAGE_SIZE);
+          TEST_CHECK(writeBlock(j, &fh, page));
+        }
+      TEST_CHECK(closePageFile(&fh));
+    }
+
+  // flushes hold the frames they write, pins wait for them
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", POOL_THREADS / 2, RS_FIFO, NULL));
+  runPoolWorkers(bm, workers, bumpOrFlush);
+  for (i = 0; i < POOL_THREADS; i++)
+    TEST_CHECK(workers[i].rc);
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  for (j = 0; j < POOL_PAGES; j++)
+    {
+      for (expected = 0, i = 0; i < POOL_THREADS; i++)
+        expected += workers[i].counts[j];
+      TEST_CHECK(readBlock(j, &fh, page));
+      ASSERT_EQUALS_INT(expected, *(int *) page, "flushes lose no updates");
+    }
+  TEST_CHECK(closePageFile(&fh));
+
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(page);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static void
+dirtyPage (BM_BufferPool *bm, BM_PageHandle *h, int pageNum)
+{
+  TEST_CHECK(pinPage(bm, h, pageNum));
+  sprintf(h->data, "Page-%i", pageNum);
+  TEST_CHECK(markDirty(bm, h));
+  TEST_CHECK(unpinPage(bm, h));
+}
+
+void
+testPageCleaner (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *other = MAKE_PAGE_HANDLE();
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+  SM_FileHandle fh;
+  char expected[16];
+  int i;
+
+  testName = "page cleaner writes ahead of the replacement hand";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(20, &fh));
+  TEST_CHECK(closePageFile(&fh));
+
+  // without the cleaner every dirty victim is written by the pin
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_CLOCK, NULL));
+  for (i = 0; i < 15; i++)
+    dirtyPage(bm, h, i);
+  ASSERT_EQUALS_INT(5, getNumEvictionWrites(bm), "pins wrote their victims");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  // with it the frames the hand reaches next are clean by then
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_CLOCK, NULL));
+  TEST_CHECK(startPageCleaner(bm, 50));
+  ASSERT_TRUE(startPageCleaner(bm, 50) != RC_OK, "one cleaner per pool");
+  for (i = 0; i < 10; i++)
+    dirtyPage(bm, h, i);
+  for (i = 0; i < 200 && getNumWriteIO(bm) < 5; i++)
+    usleep(10000);
+  ASSERT_TRUE(getNumWriteIO(bm) >= 5, "cleaner wrote half the frames");
+  for (i = 10; i < 15; i++)
+    pinAndUnpin(bm, h, i);
+  ASSERT_EQUALS_INT(0, getNumEvictionWrites(bm), "pins found clean victims");
+  TEST_CHECK(stopPageCleaner(bm));
+  TEST_CHECK(stopPageCleaner(bm));
+
+  // a running cleaner is stopped by the shutdown
+  TEST_CHECK(startPageCleaner(bm, 100));
+  for (i = 0; i < 20; i++)
+    dirtyPage(bm, h, 19 - i);
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  for (i = 0; i < 20; i++)
+    {
+      TEST_CHECK(readBlock(i, &fh, page));
+      sprintf(expected, "Page-%i", i);
+      ASSERT_EQUALS_STRING(expected, page, "page written back");
+    }
+  TEST_CHECK(closePageFile(&fh));
+
+  // pins wait for the frames the cleaner holds, in a pool they fill
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_FIFO, NULL));
+  TEST_CHECK(startPageCleaner(bm, 100));
+  for (i = 0; i < 5000; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i % 20));
+      sprintf(h->data, "Page-%i", i % 20);
+      TEST_CHECK(markDirty(bm, h));
+      TEST_CHECK(pinPage(bm, other, (i + 7) % 20));
+      sprintf(other->data, "Page-%i", (i + 7) % 20);
+      TEST_CHECK(markDirty(bm, other));
+      TEST_CHECK(unpinPage(bm, other));
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  free(other);
+  free(page);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static void
+waitForReads (BM_BufferPool *bm, int reads)
+{
+  int i;
+  for (i = 0; i < 200 && getNumReadIO(bm) < reads; i++)
+    usleep(10000);
+}
+
+void
+testPrefetch (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  PageNumber *frames;
+  int *fixCounts;
+  char expected[16];
+  int i;
+
+  testName = "prefetching reads pages ahead of their pins";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(40, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 16, RS_LRU, NULL));
+  for (i = 0; i < 40; i++)
+    dirtyPage(bm, h, i);
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  // prefetched pages are in the pool unpinned, their pins are hits
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 16, RS_LRU, NULL));
+  TEST_CHECK(prefetchPages(bm, 4, 4));
+  waitForReads(bm, 4);
+  ASSERT_EQUALS_INT(4, getNumReadIO(bm), "prefetch read the pages");
+  fixCounts = getFixCounts(bm);
+  for (i = 0; i < 16; i++)
+    ASSERT_EQUALS_INT(0, fixCounts[i], "prefetched pages are not pinned");
+  free(fixCounts);
+  for (i = 4; i < 8; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      sprintf(expected, "Page-%i", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "prefetched page content");
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(4, getNumReadIO(bm), "pins of prefetched pages read nothing");
+
+  // pages past the end of the file are left out
+  TEST_CHECK(prefetchPages(bm, 40, 2));
+  TEST_CHECK(prefetchPages(bm, 38, 2));
+  waitForReads(bm, 6);
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "read the pages in the file");
+  frames = getFrameContents(bm);
+  for (i = 0; i < 16; i++)
+    ASSERT_TRUE(frames[i] < 40, "no frame for pages past the end");
+  free(frames);
+  ASSERT_TRUE(prefetchPages(bm, -1, 2) != RC_OK, "negative page");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  // without read-ahead a run of pins reads only its own pages
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 16, RS_LRU, NULL));
+  for (i = 0; i < 6; i++)
+    pinAndUnpin(bm, h, i);
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "read-ahead is off by default");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  // with it a run of three pins has the next eight pages read ahead
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 16, RS_LRU, NULL));
+  TEST_CHECK(setReadAhead(bm, 8));
+  for (i = 0; i < 3; i++)
+    {
+      pinAndUnpin(bm, h, i);
+      pinAndUnpin(bm, h, i);
+    }
+  waitForReads(bm, 11);
+  ASSERT_EQUALS_INT(11, getNumReadIO(bm), "read eight pages ahead");
+  for (i = 3; i < 6; i++)
+    pinAndUnpin(bm, h, i);
+  ASSERT_EQUALS_INT(11, getNumReadIO(bm), "pins of the run are hits");
+  // half the pages ahead are used, the next ones are queued
+  pinAndUnpin(bm, h, 6);
+  waitForReads(bm, 15);
+  ASSERT_EQUALS_INT(15, getNumReadIO(bm), "read-ahead kept up with the run");
+  for (i = 7; i < 15; i++)
+    {
+      TEST_CHECK(pinPage(bm, h, i));
+      sprintf(expected, "Page-%i", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page read ahead");
+      TEST_CHECK(unpinPage(bm, h));
+    }
+  waitForReads(bm, 23);
+  ASSERT_EQUALS_INT(23, getNumReadIO(bm), "read-ahead stayed a window ahead of the run");
+  ASSERT_TRUE(setReadAhead(bm, -1) != RC_OK, "negative read-ahead");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testWriteErrors (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+  SM_FileHandle fh;
+  struct rlimit limit, full;
+  PageNumber *frames;
+  bool *dirty;
+  // pages from here on are past the file size limit set below
+  int far = (1 << 30) / PAGE_SIZE;
+
+  testName = "failed writes keep pages dirty and return the error";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(3, &fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_FIFO, NULL));
+
+  // the file cannot grow to page far, like a full disk
+  signal(SIGXFSZ, SIG_IGN);
+  getrlimit(RLIMIT_FSIZE, &full);
+  limit = full;
+  limit.rlim_cur = (rlim_t) far * PAGE_SIZE;
+  setrlimit(RLIMIT_FSIZE, &limit);
+
+  TEST_CHECK(pinPage(bm, h, far + 5));
+  strcpy(h->data, "Page-5");
+  TEST_CHECK(markDirty(bm, h));
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, forcePage(bm, h), "forcePage returns the error");
+  TEST_CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, forceFlushPool(bm), "forceFlushPool returns the error");
+  dirty = getDirtyFlags(bm);
+  ASSERT_TRUE(dirty[0], "page stays dirty");
+  free(dirty);
+
+  // the dirty victim is not replaced when its write fails
+  TEST_CHECK(pinPage(bm, h, far + 6));
+  strcpy(h->data, "Page-6");
+  TEST_CHECK(markDirty(bm, h));
+  TEST_CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, pinPage(bm, h, 0), "pin returns the write error");
+  frames = getFrameContents(bm);
+  ASSERT_EQUALS_INT(far + 5, frames[0], "victim keeps its page");
+  free(frames);
+  TEST_CHECK(pinPage(bm, h, far + 5));
+  ASSERT_EQUALS_STRING("Page-5", h->data, "victim keeps its content");
+  TEST_CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, shutdownBufferPool(bm), "shutdown returns the error");
+
+  // once the writes go through nothing was lost
+  setrlimit(RLIMIT_FSIZE, &full);
+  signal(SIGXFSZ, SIG_DFL);
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(readBlock(far + 5, &fh, page));
+  ASSERT_EQUALS_STRING("Page-5", page, "page 5 written at last");
+  TEST_CHECK(readBlock(far + 6, &fh, page));
+  ASSERT_EQUALS_STRING("Page-6", page, "page 6 written at last");
+  TEST_CHECK(closePageFile(&fh));
+
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  free(page);
+
+  TEST_DONE();
+}
+
+// ************************************************************ 
+static int
+fileDescriptor (char *fileName)
+{
+  struct stat file, opened;
+  int fd;
+
+  stat(fileName, &file);
+  for(fd = 0; fd < 1024; fd++)
+    if(fstat(fd, &opened) == 0 && opened.st_dev == file.st_dev && opened.st_ino == file.st_ino)
+      return fd;
+  return -1;
+}
+
+void
+testReadErrors (void)
+{
+  ReplacementStrategy strategies[] = { RS_LRU, RS_LFU, RS_LRU_K, RS_ARC };
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *other = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  PageNumber *frames;
+  int i, fd, saved, writeOnly;
+
+  testName = "failed reads give their frame back";
+
+  TEST_CHECK(createPageFile("testbuffer.bin"));
+  TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+  TEST_CHECK(ensureCapacity(5, &fh));
+  TEST_CHECK(closePageFile(&fh));
+
+  for(i = 0; i < 4; i++)
+    {
+      TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, strategies[i], NULL));
+      TEST_CHECK(pinPage(bm, h, 0));
+      TEST_CHECK(unpinPage(bm, h));
+
+      // reads through a write only descriptor fail like a bad disk
+      fd = fileDescriptor("testbuffer.bin");
+      ASSERT_TRUE(fd >= 0, "pool keeps its page file open");
+      saved = dup(fd);
+      writeOnly = open("testbuffer.bin", O_WRONLY);
+      dup2(writeOnly, fd);
+      ASSERT_EQUALS_INT(RC_READ_ERROR, pinPage(bm, h, 1), "pin returns the read error");
+      ASSERT_EQUALS_INT(RC_READ_ERROR, pinPage(bm, h, 2), "empty frame is taken again");
+      dup2(saved, fd);
+      close(saved);
+      close(writeOnly);
+
+      frames = getFrameContents(bm);
+      ASSERT_TRUE(frames[0] == 0 || frames[1] == 0, "resident page is not evicted");
+      free(frames);
+
+      // both frames are still there to hold pages
+      TEST_CHECK(pinPage(bm, h, 3));
+      TEST_CHECK(pinPage(bm, other, 4));
+      ASSERT_EQUALS_INT(3, h->pageNum, "first page pinned");
+      ASSERT_EQUALS_INT(4, other->pageNum, "second page pinned");
+      TEST_CHECK(unpinPage(bm, h));
+      TEST_CHECK(unpinPage(bm, other));
+      TEST_CHECK(shutdownBufferPool(bm));
+    }
+
+  TEST_CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+  free(other);
+
+  TEST_DONE();
+}
+
 // ************************************************************ 
 int *
 createPermutation (int size)